@@ -0,0 +1,209 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <pthread.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GLStateCache.h"
+#include "Log.h"
+#include "SpscQueue.h"
+
+// Uploads GPU data on its own thread through a context shared with the renderer's.
+// The loader context is current on a 1x1 pbuffer and only ever creates shareable objects
+// (buffers, textures); container objects such as VAOs are not shared between contexts
+// and have to be made by the renderer when it takes the resource over. Each finished
+// upload is fenced, and poll() on the render thread only hands over uploads whose fence
+// has already signalled, so drawFrame() never waits on the loader or the GPU.
+class AssetLoader {
+public:
+    struct Request {
+        bool (*upload)(void* context);            // Loader thread, loader context current
+        void (*complete)(void* context, bool ok); // Render thread, from poll()
+        void* context;
+    };
+
+private:
+    static constexpr size_t kQueueSize = 64;
+
+    struct Result {
+        Request request;
+        GLsync fence;
+        bool ok;
+    };
+
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    std::thread mThread;
+    std::atomic<bool> mStop{false};
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mStartFailed{false};
+
+    SpscQueue<Request, kQueueSize> mRequests;
+    SpscQueue<Result, kQueueSize> mResults;
+    std::vector<Result> mPending;  // Render thread only, waiting for their fences
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCondition;
+    uint64_t mSubmitted = 0;
+    uint64_t mSeen = 0;
+
+    void loaderLoop() {
+        pthread_setname_np(pthread_self(), "AssetLoader");
+        if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+            LOG_ERROR("Asset loader failed to make its context current");
+            mStartFailed.store(true, std::memory_order_release);
+            return;
+        }
+        GLStateCache::current().reset();
+        mRunning.store(true, std::memory_order_release);
+
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mWakeCondition.wait(lock, [this] {
+                    return mStop.load(std::memory_order_relaxed) || mSubmitted != mSeen;
+                });
+                if (mStop.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                mSeen = mSubmitted;
+            }
+
+            Request request;
+            while (!stopping && mRequests.pop(request)) {
+                bool ok = request.upload(request.context);
+                // The flush gets the fence to the GPU so the render context can see it signal
+                GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+                while (!mResults.push({request, fence, ok})) {
+                    // The render thread stops polling once it is in stop(), so a full ring never drains
+                    if (mStop.load(std::memory_order_relaxed)) {
+                        glDeleteSync(fence);
+                        stopping = true;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // The render thread is blocked in stop() until this returns, so the fences it never
+        // picked up are deleted here, while a context that shares them is still current
+        Result result;
+        while (mResults.pop(result)) {
+            mPending.push_back(result);
+        }
+        for (Result& pending : mPending) {
+            glDeleteSync(pending.fence);
+        }
+        mPending.clear();
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+
+public:
+    AssetLoader() = default;
+    ~AssetLoader() {
+        stop();
+    }
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Render thread; config has to support pbuffers. Waits until the loader context is
+    // current, so a false return means every upload has to happen on the caller's thread
+    bool start(EGLDisplay display, EGLConfig config, EGLContext shareContext) {
+        mDisplay = display;
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+        mContext = eglCreateContext(display, config, shareContext, contextAttribs);
+        const EGLint surfaceAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        mSurface = mContext != EGL_NO_CONTEXT ? eglCreatePbufferSurface(display, config, surfaceAttribs)
+                                              : EGL_NO_SURFACE;
+        if (mSurface == EGL_NO_SURFACE) {
+            LOG_ERROR("Failed to create the asset loader context");
+            stop();
+            return false;
+        }
+
+        mStop.store(false, std::memory_order_relaxed);
+        mStartFailed.store(false, std::memory_order_relaxed);
+        mThread = std::thread(&AssetLoader::loaderLoop, this);
+        while (!mRunning.load(std::memory_order_acquire)) {
+            if (mStartFailed.load(std::memory_order_acquire)) {
+                stop();
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Render thread; uploads not yet handed over are dropped without their completion
+    void stop() {
+        if (mThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+                mStop.store(true, std::memory_order_relaxed);
+            }
+            mWakeCondition.notify_one();
+            mThread.join();
+        }
+        mRunning.store(false, std::memory_order_relaxed);
+
+        Request request;
+        while (mRequests.pop(request)) {}
+
+        if (mSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(mDisplay, mSurface);
+            mSurface = EGL_NO_SURFACE;
+        }
+        if (mContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(mDisplay, mContext);
+            mContext = EGL_NO_CONTEXT;
+        }
+    }
+
+    [[nodiscard]]
+    bool isRunning() const {
+        return mRunning.load(std::memory_order_relaxed);
+    }
+
+    // Render thread
+    bool submit(const Request& request) {
+        if (!isRunning() || !mRequests.push(request)) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            ++mSubmitted;
+        }
+        mWakeCondition.notify_one();
+        return true;
+    }
+
+    // Render thread, once per frame; completes uploads the GPU has finished, never blocks
+    void poll() {
+        Result result;
+        while (mResults.pop(result)) {
+            mPending.push_back(result);
+        }
+
+        size_t kept = 0;
+        for (Result& pending : mPending) {
+            GLenum status = pending.fence ? glClientWaitSync(pending.fence, 0, 0) : GL_ALREADY_SIGNALED;
+            if (status == GL_TIMEOUT_EXPIRED) {
+                mPending[kept++] = pending;
+                continue;
+            }
+            glDeleteSync(pending.fence);
+            pending.request.complete(pending.request.context, pending.ok && status != GL_WAIT_FAILED);
+        }
+        mPending.resize(kept);
+    }
+};
@@ -0,0 +1,682 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <sys/system_properties.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "GLStateCache.h"
+#include "GpuCuller.h"
+#include "Log.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+#include "Shaders.h"
+#include "SimdMath.h"
+#include "StreamBuffer.h"
+#include "TriangleMesh.h"
+#include "UniformRing.h"
+#include "Uniforms.h"
+
+// Headless benchmark.
+// Renders a fixed set of scenes into an offscreen framebuffer for a fixed number of
+// frames each, with no vsync, and writes the results as JSON. Each frame ends with
+// glFinish so its time covers the GPU work and not just command submission. The run
+// goes one scene per step(), so the caller can handle other work between scenes.
+class Benchmark {
+private:
+    enum class SceneType {
+        Triangles,     // One draw call with many triangles
+        IndexedHalf,   // The same triangle count as a shared-vertex grid with half-float positions
+        DrawCalls,     // Many draw calls of a single triangle
+        FillRate,      // Full-screen blended quads stacked on each other
+        StateChanges,  // Alternating program and vertex array every draw
+        Instanced,     // One instanced draw call of many transformed triangles
+        Streamed,      // Instanced, with every transform rewritten each frame through a StreamBuffer
+        Queued,        // Interleaved submissions sorted and merged by the RenderQueue
+        GpuDriven      // Culled by a compute pass into an indirect draw, with no CPU work per object
+    };
+
+    struct Scene {
+        const char* name;
+        SceneType type;
+        uint32_t count;
+    };
+
+    struct SceneResult {
+        const char* name;
+        uint64_t drawCalls;
+        uint64_t triangles;
+        std::vector<int64_t> frameTimes;
+    };
+
+    static constexpr Scene kScenes[] = {
+        {"triangles", SceneType::Triangles, 100000},
+        {"indexed_half", SceneType::IndexedHalf, 100000},
+        {"draw_calls", SceneType::DrawCalls, 10000},
+        {"fill_rate", SceneType::FillRate, 20},
+        {"state_changes", SceneType::StateChanges, 5000},
+        {"instanced", SceneType::Instanced, 20000},
+        {"streamed", SceneType::Streamed, 20000},
+        {"queued", SceneType::Queued, 10000},
+        {"gpu_driven", SceneType::GpuDriven, 100000},
+    };
+    static constexpr uint32_t kWarmupFrames = 30;
+    static constexpr uint32_t kCullingSpheres = 100000;
+    static constexpr uint32_t kTransformCount = 20000;
+
+    // CPU-only culling timings, median per pass over kCullingSpheres
+    struct CullingResult {
+        uint32_t visible;
+        double simdMs;
+        double scalarMs;
+    };
+
+    // CPU-only instance matrix building, median per pass over kTransformCount objects
+    struct TransformResult {
+        double simdMs;
+        double scalarMs;
+    };
+
+    static constexpr char kAltFragmentShaderSource[] = R"(#version 320 es
+    precision mediump float;
+    out vec4 FragColor;
+    void main() {
+        FragColor = vec4(1.0, 0.0, 0.0, 0.5);
+    })";
+
+    GLsizei mWidth = 0;
+    GLsizei mHeight = 0;
+    GLuint mFramebuffer = 0;
+    GLuint mColorBuffer = 0;
+    ShaderProgram mProgram;
+    ShaderProgram mAltProgram;
+    ShaderProgram mInstancedProgram;
+    TriangleMesh mTriangle;
+    TriangleMesh mInstancedTriangle;
+    TriangleMesh mStreamedTriangle;
+    StreamBuffer mStreamBuffer;
+    std::vector<InstanceData> mStreamedInstances;
+    TriangleMesh mQueueTriangles[2];
+    RenderQueue mRenderQueue;
+    RenderQueue::Handle mQueueProgram = 0;
+    RenderQueue::Handle mQueueMeshes[2] = {};
+    RenderQueue::Handle mQueueMaterials[2] = {};
+    // Identity frame and white batch constants for the instanced scenes that bypass the queue
+    GLuint mDefaultUniforms = 0;
+    GLintptr mDefaultBatchOffset = 0;
+    uint32_t mFrameIndex = 0;
+    // Progress of the run, from start() to the last step()
+    uint32_t mFrames = 0;
+    std::string mOutputPath;
+    size_t mNextScene = 0;
+    std::vector<SceneResult> mResults;
+    bool mFinished = false;
+    TriangleMesh mGpuTriangle;
+    GpuCuller mGpuCuller;
+    TriangleMesh mAltTriangle;
+    TriangleMesh mManyTriangles;
+    TriangleMesh mIndexedGrid;
+    TriangleMesh mQuad;
+
+    static constexpr uint32_t sceneCount(SceneType type) {
+        for (const Scene& scene : kScenes) {
+            if (scene.type == type) {
+                return scene.count;
+            }
+        }
+        return 0;
+    }
+
+    void bindDefaultUniforms() {
+        glBindBufferRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlock::Frame), mDefaultUniforms,
+                          0, sizeof(FrameUniforms));
+        glBindBufferRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlock::Batch), mDefaultUniforms,
+                          mDefaultBatchOffset, sizeof(BatchUniforms));
+        GLStateCache::current().onIndexedBufferBound(GL_UNIFORM_BUFFER, mDefaultUniforms);
+    }
+
+    static int64_t nowNanos() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    static double percentileMs(std::vector<int64_t> samples, double fraction) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        auto nth = samples.begin() + static_cast<ptrdiff_t>(fraction * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth / 1e6;
+    }
+
+    static std::string escapeJson(const char* value) {
+        std::string escaped;
+        for (const char* c = value ? value : ""; *c; ++c) {
+            if (*c == '"' || *c == '\\') {
+                escaped += '\\';
+            }
+            if (static_cast<unsigned char>(*c) >= 0x20) {
+                escaped += *c;
+            }
+        }
+        return escaped;
+    }
+
+    // Grid of small triangles covering the viewport, so the cost is vertex-bound
+    static std::vector<float> buildTriangleGrid(uint32_t count) {
+        auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        float cell = 2.0f / columns;
+        std::vector<float> positions;
+        positions.reserve(count * 9);
+        for (uint32_t i = 0; i < count; ++i) {
+            float x = -1.0f + (i % columns) * cell;
+            float y = -1.0f + (i / columns) * cell;
+            const float triangle[] = {
+                x, y, 0.0f,
+                x + cell, y, 0.0f,
+                x, y + cell, 0.0f,
+            };
+            positions.insert(positions.end(), std::begin(triangle), std::end(triangle));
+        }
+        return positions;
+    }
+
+    struct IndexedGrid {
+        std::vector<uint16_t> vertices;  // Half4 positions
+        std::vector<uint16_t> indices;
+    };
+
+    // Full-screen grid of quads with at least count triangles, small enough for 16-bit indices
+    static IndexedGrid buildIndexedGrid(uint32_t count) {
+        auto side = static_cast<uint32_t>(std::ceil(std::sqrt(count / 2.0)));
+        side = std::min<uint32_t>(side, 255);
+        uint32_t row = side + 1;
+        float cell = 2.0f / side;
+
+        IndexedGrid grid;
+        grid.vertices.reserve(row * row * 4);
+        for (uint32_t y = 0; y < row; ++y) {
+            for (uint32_t x = 0; x < row; ++x) {
+                grid.vertices.push_back(VertexPacking::toHalf(-1.0f + x * cell));
+                grid.vertices.push_back(VertexPacking::toHalf(-1.0f + y * cell));
+                grid.vertices.push_back(VertexPacking::toHalf(0.0f));
+                grid.vertices.push_back(VertexPacking::toHalf(1.0f));
+            }
+        }
+
+        grid.indices.reserve(side * side * 6);
+        for (uint32_t y = 0; y < side; ++y) {
+            for (uint32_t x = 0; x < side; ++x) {
+                auto corner = static_cast<uint16_t>(y * row + x);
+                const uint16_t quad[] = {
+                    corner, static_cast<uint16_t>(corner + 1), static_cast<uint16_t>(corner + row),
+                    static_cast<uint16_t>(corner + 1), static_cast<uint16_t>(corner + row + 1),
+                    static_cast<uint16_t>(corner + row),
+                };
+                grid.indices.insert(grid.indices.end(), std::begin(quad), std::end(quad));
+            }
+        }
+        return grid;
+    }
+
+    // Same grid layout as buildTriangleGrid, expressed as per-instance scale and offset
+    static std::vector<InstanceData> buildInstanceGrid(uint32_t count) {
+        auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        float cell = 2.0f / columns;
+        std::vector<InstanceData> instances(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            InstanceData& instance = instances[i];
+            float* m = instance.transform;
+            std::fill(m, m + 16, 0.0f);
+            m[0] = cell;
+            m[5] = cell;
+            m[10] = 1.0f;
+            m[12] = -1.0f + (i % columns + 0.5f) * cell;
+            m[13] = -1.0f + (i / columns + 0.5f) * cell;
+            m[15] = 1.0f;
+            instance.color[0] = static_cast<float>(i % columns) / columns;
+            instance.color[1] = static_cast<float>(i / columns) / columns;
+            instance.color[2] = 0.5f;
+            instance.color[3] = 1.0f;
+        }
+        return instances;
+    }
+
+    // Returns draw calls and triangles issued
+    std::pair<uint64_t, uint64_t> renderScene(const Scene& scene) {
+        GLStateCache& state = GLStateCache::current();
+        state.clearColor(0.3f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        switch (scene.type) {
+            case SceneType::Triangles: {
+                mProgram.use();
+                mManyTriangles.draw();
+                return {1, static_cast<uint64_t>(mManyTriangles.vertexCount() / 3)};
+            }
+
+            case SceneType::IndexedHalf: {
+                mProgram.use();
+                mIndexedGrid.draw();
+                return {1, static_cast<uint64_t>(mIndexedGrid.drawCount() / 3)};
+            }
+
+            case SceneType::DrawCalls: {
+                mProgram.use();
+                for (uint32_t i = 0; i < scene.count; ++i) {
+                    mTriangle.draw();
+                }
+                return {scene.count, scene.count};
+            }
+
+            case SceneType::FillRate: {
+                state.setBlend(true);
+                state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                mAltProgram.use();
+                for (uint32_t i = 0; i < scene.count; ++i) {
+                    mQuad.draw();
+                }
+                state.setBlend(false);
+                return {scene.count, scene.count * 2ULL};
+            }
+
+            case SceneType::StateChanges: {
+                for (uint32_t i = 0; i < scene.count; ++i) {
+                    if (i & 1) {
+                        mAltProgram.use();
+                        mAltTriangle.draw();
+                    } else {
+                        mProgram.use();
+                        mTriangle.draw();
+                    }
+                }
+                return {scene.count, scene.count};
+            }
+
+            case SceneType::Instanced: {
+                bindDefaultUniforms();
+                mInstancedProgram.use();
+                mInstancedTriangle.drawInstanced(static_cast<GLsizei>(scene.count));
+                return {1, scene.count};
+            }
+
+            case SceneType::Streamed: {
+                // Slide every instance a little each frame so the whole buffer really changes
+                float shift = (mFrameIndex++ % 60) * 0.001f;
+                mStreamBuffer.beginFrame();
+                StreamBuffer::Allocation allocation =
+                        mStreamBuffer.allocate(static_cast<GLsizeiptr>(scene.count * sizeof(InstanceData)));
+                if (allocation.data) {
+                    auto* instances = static_cast<InstanceData*>(allocation.data);
+                    for (uint32_t i = 0; i < scene.count; ++i) {
+                        instances[i] = mStreamedInstances[i];
+                        instances[i].transform[12] += shift;
+                    }
+                    mStreamBuffer.commit(allocation);
+                    mStreamedTriangle.bindInstanceSource(mStreamBuffer.buffer(), allocation.offset);
+                    bindDefaultUniforms();
+                    mInstancedProgram.use();
+                    mStreamedTriangle.drawInstanced(static_cast<GLsizei>(scene.count));
+                }
+                mStreamBuffer.endFrame();
+                return {1, scene.count};
+            }
+
+            case SceneType::Queued: {
+                // Worst-case submission order: every packet switches mesh or material
+                for (uint32_t i = 0; i < scene.count; ++i) {
+                    mRenderQueue.submit(mQueueProgram, mQueueMeshes[i & 1], mQueueMaterials[(i >> 1) & 1],
+                                        static_cast<float>(i) / scene.count, mStreamedInstances[i]);
+                }
+                mRenderQueue.flush();
+                return {mRenderQueue.stats().batches, scene.count};
+            }
+
+            case SceneType::GpuDriven: {
+                // The whole grid is on screen, so every object survives the cull
+                mGpuCuller.cull();
+                uint32_t draws = mGpuCuller.draw(mInstancedProgram);
+                return {draws, scene.count};
+            }
+        }
+        return {0, 0};
+    }
+
+    // Spheres scattered over twice the frustum's extent on each axis, so roughly an eighth survive
+    static CullingResult measureCulling(uint32_t passes) {
+        BoundsSoA bounds;
+        uint32_t seed = 1;
+        auto random = [&seed] {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+        };
+        for (uint32_t i = 0; i < kCullingSpheres; ++i) {
+            bounds.push(random() * 4.0f - 2.0f, random() * 4.0f - 2.0f, random() * 4.0f - 2.0f, random() * 0.1f);
+        }
+
+        FrustumCuller culler;
+        culler.setViewProjection(Mat4::identity().m);
+        std::vector<uint32_t> visible(kCullingSpheres);
+
+        CullingResult result{0, 0.0, 0.0};
+        for (FrustumCuller::Kernel kernel : {FrustumCuller::Kernel::Simd, FrustumCuller::Kernel::Scalar}) {
+            culler.setKernel(kernel);
+            std::vector<int64_t> times;
+            times.reserve(passes);
+            for (uint32_t pass = 0; pass < passes; ++pass) {
+                int64_t start = nowNanos();
+                result.visible = culler.cull(bounds, 0, kCullingSpheres, visible.data());
+                times.push_back(nowNanos() - start);
+            }
+            (kernel == FrustumCuller::Kernel::Simd ? result.simdMs : result.scalarMs) = percentileMs(times, 0.5);
+        }
+        return result;
+    }
+
+    static TransformResult measureTransforms(uint32_t passes) {
+        TransformSoA transforms;
+        for (uint32_t i = 0; i < kTransformCount; ++i) {
+            float angle = static_cast<float>(i) * 0.01f;
+            transforms.push({std::cos(angle), std::sin(angle), 0.0f}, Quat::fromAxisAngle({0.0f, 0.0f, 1.0f}, angle),
+                            0.05f);
+        }
+
+        std::vector<InstanceData> instances(kTransformCount);
+        const size_t stride = sizeof(InstanceData) / sizeof(float);
+        TransformResult result{0.0, 0.0};
+        for (bool simd : {true, false}) {
+            std::vector<int64_t> times;
+            times.reserve(passes);
+            for (uint32_t pass = 0; pass < passes; ++pass) {
+                int64_t start = nowNanos();
+                if (simd) {
+                    composeTransforms(transforms, 0, kTransformCount, instances[0].transform, stride);
+                } else {
+                    composeTransformsScalar(transforms, 0, kTransformCount, instances[0].transform, stride);
+                }
+                times.push_back(nowNanos() - start);
+            }
+            (simd ? result.simdMs : result.scalarMs) = percentileMs(times, 0.5);
+        }
+        return result;
+    }
+
+    bool writeResults(const char* path, uint32_t frames, const std::vector<SceneResult>& results,
+                      const CullingResult& culling, const TransformResult& transforms) const {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            LOG_ERROR("Failed to open %s", path);
+            return false;
+        }
+
+        char model[PROP_VALUE_MAX] = {};
+        __system_property_get("ro.product.model", model);
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"device\": \"%s\",\n", escapeJson(model).c_str());
+        fprintf(file, "  \"gl_vendor\": \"%s\",\n",
+                escapeJson(reinterpret_cast<const char*>(glGetString(GL_VENDOR))).c_str());
+        fprintf(file, "  \"gl_renderer\": \"%s\",\n",
+                escapeJson(reinterpret_cast<const char*>(glGetString(GL_RENDERER))).c_str());
+        fprintf(file, "  \"gl_version\": \"%s\",\n",
+                escapeJson(reinterpret_cast<const char*>(glGetString(GL_VERSION))).c_str());
+        fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %u,\n", mWidth, mHeight, frames);
+        fprintf(file, "  \"scenes\": [\n");
+
+        for (size_t i = 0; i < results.size(); ++i) {
+            const SceneResult& result = results[i];
+            int64_t total = 0;
+            for (int64_t frameTime : result.frameTimes) {
+                total += frameTime;
+            }
+            double seconds = total / 1e9;
+            double frameCount = static_cast<double>(result.frameTimes.size());
+
+            fprintf(file, "    {\n");
+            fprintf(file, "      \"name\": \"%s\",\n", result.name);
+            fprintf(file, "      \"draw_calls_per_frame\": %" PRIu64 ",\n", result.drawCalls);
+            fprintf(file, "      \"triangles_per_frame\": %" PRIu64 ",\n", result.triangles);
+            fprintf(file, "      \"frame_time_ms\": {\"avg\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f},\n",
+                    frameCount > 0 ? total / 1e6 / frameCount : 0.0,
+                    percentileMs(result.frameTimes, 0.50),
+                    percentileMs(result.frameTimes, 0.95),
+                    percentileMs(result.frameTimes, 0.99));
+            fprintf(file, "      \"draw_calls_per_sec\": %.0f,\n",
+                    seconds > 0 ? result.drawCalls * frameCount / seconds : 0.0);
+            fprintf(file, "      \"triangles_per_sec\": %.0f\n",
+                    seconds > 0 ? result.triangles * frameCount / seconds : 0.0);
+            fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+
+        fprintf(file, "  ],\n");
+        fprintf(file, "  \"culling\": {\"kernel\": \"%s\", \"spheres\": %u, \"visible\": %u, "
+                      "\"simd_ms\": %.3f, \"scalar_ms\": %.3f},\n",
+                FrustumCuller::kSimdName, kCullingSpheres, culling.visible, culling.simdMs, culling.scalarMs);
+        fprintf(file, "  \"transforms\": {\"kernel\": \"%s\", \"objects\": %u, "
+                      "\"simd_ms\": %.3f, \"scalar_ms\": %.3f}\n",
+                simd::kName, kTransformCount, transforms.simdMs, transforms.scalarMs);
+        fprintf(file, "}\n");
+        return fclose(file) == 0;
+    }
+
+public:
+    Benchmark() = default;
+    ~Benchmark() {
+        cleanup();
+    }
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    // Must be called with a current context
+    bool initialize(GLsizei width, GLsizei height, const ProgramCache* cache) {
+        mWidth = width;
+        mHeight = height;
+
+        glGenRenderbuffers(1, &mColorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenFramebuffers(1, &mFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("Benchmark framebuffer incomplete");
+            return false;
+        }
+
+        if (!mProgram.initialize(Shaders::vertexShaderSource, Shaders::fragmentShaderSource, cache) ||
+            !mAltProgram.initialize(Shaders::vertexShaderSource, kAltFragmentShaderSource, cache) ||
+            !mInstancedProgram.initialize(Shaders::instancedVertexShaderSource,
+                                          Shaders::instancedFragmentShaderSource, cache)) {
+            LOG_ERROR("Failed to create benchmark programs");
+            return false;
+        }
+
+        const float altTriangle[] = {
+            -0.5f,  0.5f, 0.0f,
+            -0.5f, -0.5f, 0.0f,
+             0.5f,  0.0f, 0.0f,
+        };
+        const float quad[] = {
+            -1.0f, -1.0f, 0.0f,  1.0f, -1.0f, 0.0f,  -1.0f, 1.0f, 0.0f,
+            -1.0f,  1.0f, 0.0f,  1.0f, -1.0f, 0.0f,   1.0f, 1.0f, 0.0f,
+        };
+        std::vector<float> grid = buildTriangleGrid(sceneCount(SceneType::Triangles));
+        IndexedGrid indexedGrid = buildIndexedGrid(sceneCount(SceneType::IndexedHalf));
+        VertexLayout halfPositions;
+        halfPositions.add(TriangleMesh::kPositionAttribute, VertexFormat::Half4);
+        uint32_t instanceCount = sceneCount(SceneType::Instanced);
+        std::vector<InstanceData> instances = buildInstanceGrid(instanceCount);
+
+        if (!mTriangle.initialize() ||
+            !mAltTriangle.initialize(altTriangle, 3) ||
+            !mQuad.initialize(quad, 6) ||
+            !mManyTriangles.initialize(grid.data(), static_cast<GLsizei>(grid.size() / 3)) ||
+            !mIndexedGrid.initialize(indexedGrid.vertices.data(), static_cast<GLsizei>(indexedGrid.vertices.size() / 4),
+                                     halfPositions, indexedGrid.indices.data(),
+                                     static_cast<GLsizei>(indexedGrid.indices.size()), GL_UNSIGNED_SHORT) ||
+            !mInstancedTriangle.initialize() ||
+            !mInstancedTriangle.enableInstancing(static_cast<GLsizei>(instanceCount))) {
+            LOG_ERROR("Failed to create benchmark meshes");
+            return false;
+        }
+        mInstancedTriangle.updateInstances(instances.data(), static_cast<GLsizei>(instanceCount));
+
+        mDefaultBatchOffset = UniformRing::offsetAlignment();
+        GLStateCache& state = GLStateCache::current();
+        glGenBuffers(1, &mDefaultUniforms);
+        state.bindBuffer(GL_UNIFORM_BUFFER, mDefaultUniforms);
+        glBufferData(GL_UNIFORM_BUFFER, mDefaultBatchOffset + static_cast<GLsizeiptr>(sizeof(BatchUniforms)),
+                     nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &kDefaultFrameUniforms);
+        glBufferSubData(GL_UNIFORM_BUFFER, mDefaultBatchOffset, sizeof(BatchUniforms), &kDefaultBatchUniforms);
+
+        uint32_t streamedCount = sceneCount(SceneType::Streamed);
+        mStreamedInstances = buildInstanceGrid(streamedCount);
+        if (!mStreamedTriangle.initialize() ||
+            !mStreamedTriangle.enableInstancing(static_cast<GLsizei>(streamedCount)) ||
+            !mStreamBuffer.initialize(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(streamedCount * sizeof(InstanceData)))) {
+            LOG_ERROR("Failed to create benchmark stream buffer");
+            return false;
+        }
+        LOG_INFO("Benchmark stream buffer is %s", mStreamBuffer.isPersistent() ? "persistently mapped" : "map-per-frame");
+
+        // Reuses the streamed scene's instances, so it can't queue more of them
+        uint32_t queuedCount = std::min(sceneCount(SceneType::Queued), streamedCount);
+        mQueueProgram = mRenderQueue.addProgram(&mInstancedProgram);
+        for (size_t i = 0; i < 2; ++i) {
+            // The queue binds its own instance source, so these meshes only need the attribute layout
+            if (!mQueueTriangles[i].initialize() || !mQueueTriangles[i].enableInstancing(1)) {
+                LOG_ERROR("Failed to create benchmark queue meshes");
+                return false;
+            }
+            mQueueMeshes[i] = mRenderQueue.addMesh(&mQueueTriangles[i]);
+        }
+        mQueueMaterials[0] = mRenderQueue.addMaterial({false});
+        mQueueMaterials[1] = mRenderQueue.addMaterial({true});
+        if (!mRenderQueue.initialize(queuedCount)) {
+            LOG_ERROR("Failed to create benchmark render queue");
+            return false;
+        }
+
+        // The triangle fits in a sphere of radius 0.71 before the grid scales it
+        std::vector<InstanceData> gpuInstances = buildInstanceGrid(sceneCount(SceneType::GpuDriven));
+        std::vector<GpuCuller::Object> gpuObjects(gpuInstances.size());
+        for (size_t i = 0; i < gpuInstances.size(); ++i) {
+            const float* m = gpuInstances[i].transform;
+            gpuObjects[i] = {{m[12], m[13], m[14], 0.71f * m[0]}, gpuInstances[i], 0, 0, {}};
+        }
+        if (!mGpuTriangle.initialize() || !mGpuTriangle.enableInstancing(1) ||
+            !mGpuCuller.initialize({&mGpuTriangle}, std::move(gpuObjects))) {
+            LOG_ERROR("Failed to create benchmark GPU culler");
+            return false;
+        }
+        mGpuCuller.setViewProjection(kDefaultFrameUniforms.viewProjection);
+
+        return true;
+    }
+
+    // Must be called with a current context, after initialize()
+    void start(uint32_t frames, const char* outputPath) {
+        mFrames = frames;
+        mOutputPath = outputPath;
+        mNextScene = 0;
+        mResults.clear();
+        mResults.reserve(std::size(kScenes));
+        mFinished = false;
+    }
+
+    // Renders the next scene. After the last one, runs the CPU-only measurements and
+    // writes the results, and the run is finished. Returns false if the run failed.
+    bool step() {
+        if (mFinished) {
+            return true;
+        }
+
+        if (mNextScene < std::size(kScenes)) {
+            // The context may have been used for something else since the previous step
+            glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+            GLStateCache::current().viewport(0, 0, mWidth, mHeight);
+
+            const Scene& scene = kScenes[mNextScene++];
+            LOG_INFO("Benchmark scene %s", scene.name);
+            SceneResult result{scene.name, 0, 0, {}};
+            result.frameTimes.reserve(mFrames);
+
+            for (uint32_t frame = 0; frame < kWarmupFrames + mFrames; ++frame) {
+                int64_t start = nowNanos();
+                auto [drawCalls, triangles] = renderScene(scene);
+                glFinish();
+                if (frame >= kWarmupFrames) {
+                    result.frameTimes.push_back(nowNanos() - start);
+                    result.drawCalls = drawCalls;
+                    result.triangles = triangles;
+                }
+            }
+            mResults.push_back(std::move(result));
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return true;
+        }
+
+        mFinished = true;
+        LOG_INFO("Benchmark culling");
+        CullingResult culling = measureCulling(mFrames);
+        LOG_INFO("Benchmark transforms");
+        TransformResult transforms = measureTransforms(mFrames);
+        if (!writeResults(mOutputPath.c_str(), mFrames, mResults, culling, transforms)) {
+            return false;
+        }
+        LOG_INFO("Benchmark results written to %s", mOutputPath.c_str());
+        return true;
+    }
+
+    [[nodiscard]]
+    bool isFinished() const {
+        return mFinished;
+    }
+
+    void cleanup() {
+        mProgram.cleanup();
+        mAltProgram.cleanup();
+        mInstancedProgram.cleanup();
+        mTriangle.cleanup();
+        mInstancedTriangle.cleanup();
+        mStreamedTriangle.cleanup();
+        mStreamBuffer.cleanup();
+        mRenderQueue.cleanup();
+        mGpuCuller.cleanup();
+        mGpuTriangle.cleanup();
+        for (TriangleMesh& mesh : mQueueTriangles) {
+            mesh.cleanup();
+        }
+        mAltTriangle.cleanup();
+        mQuad.cleanup();
+        mManyTriangles.cleanup();
+        mIndexedGrid.cleanup();
+        if (mDefaultUniforms) {
+            GLStateCache::current().onBufferDeleted(mDefaultUniforms);
+            glDeleteBuffers(1, &mDefaultUniforms);
+            mDefaultUniforms = 0;
+        }
+
+        if (mFramebuffer) {
+            glDeleteFramebuffers(1, &mFramebuffer);
+            mFramebuffer = 0;
+        }
+        if (mColorBuffer) {
+            glDeleteRenderbuffers(1, &mColorBuffer);
+            mColorBuffer = 0;
+        }
+    }
+};
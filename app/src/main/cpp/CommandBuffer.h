@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include "FrameAllocator.h"
+#include "Log.h"
+#include "RenderQueue.h"
+
+// Draw commands recorded on any thread and replayed on the thread owning the GL context.
+// Commands refer to RenderQueue handles rather than GL objects, so recording never
+// touches GL. Each buffer has exactly one writer between begin() and end(); end()
+// publishes the commands to the replaying thread, no lock involved. Commands live in
+// the frame arena, so recording doesn't go through malloc.
+class alignas(64) CommandBuffer {
+public:
+    struct Draw {
+        RenderQueue::Handle program;
+        RenderQueue::Handle mesh;
+        RenderQueue::Handle material;
+        float depth;
+        InstanceData instance;
+    };
+
+private:
+    Draw* mDraws = nullptr;
+    size_t mCapacity = 0;
+    size_t mCount = 0;
+    std::atomic<bool> mRecorded{false};
+
+public:
+    CommandBuffer() = default;
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    // Recording thread only, and only once the previous contents were replayed
+    void begin(FrameAllocator& allocator, size_t maxDraws) {
+        mDraws = allocator.allocate<Draw>(maxDraws);
+        mCapacity = mDraws ? maxDraws : 0;
+        mCount = 0;
+    }
+
+    // Draws beyond maxDraws, or all of them when the arena was full, are dropped
+    void draw(RenderQueue::Handle program, RenderQueue::Handle mesh, RenderQueue::Handle material, float depth,
+              const InstanceData& instance) {
+        if (mCount < mCapacity) {
+            mDraws[mCount++] = {program, mesh, material, depth, instance};
+        }
+    }
+
+    void end() {
+        mRecorded.store(true, std::memory_order_release);
+    }
+
+    [[nodiscard]]
+    bool isRecorded() const {
+        return mRecorded.load(std::memory_order_acquire);
+    }
+
+    // GL thread only; hands the buffer back for the next recording
+    void replay(RenderQueue& queue) {
+        for (size_t i = 0; i < mCount; ++i) {
+            const Draw& draw = mDraws[i];
+            queue.submit(draw.program, draw.mesh, draw.material, draw.depth, draw.instance);
+        }
+        mRecorded.store(false, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    size_t drawCount() const {
+        return mCount;
+    }
+};
+
+// The command buffers of one frame, one per recording thread.
+// The GL thread calls beginFrame() with the number of buffers in use, recording threads
+// each fill buffer(index), and replay() feeds them to the render queue in index order,
+// so the result doesn't depend on which thread finished first.
+class CommandRecorder {
+private:
+    std::unique_ptr<CommandBuffer[]> mBuffers;
+    size_t mCapacity = 0;
+    size_t mActive = 0;
+
+public:
+    explicit CommandRecorder(size_t capacity)
+        : mBuffers(std::make_unique<CommandBuffer[]>(capacity)), mCapacity(capacity) {}
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    // Every buffer below bufferCount must be recorded before replay()
+    void beginFrame(size_t bufferCount) {
+        if (bufferCount > mCapacity) {
+            LOG_ERROR("Only %zu command buffers, %zu requested", mCapacity, bufferCount);
+            bufferCount = mCapacity;
+        }
+        mActive = bufferCount;
+    }
+
+    [[nodiscard]]
+    size_t bufferCount() const {
+        return mActive;
+    }
+
+    CommandBuffer& buffer(size_t index) {
+        return mBuffers[index];
+    }
+
+    // Waits for buffers still being recorded; by the time the GL thread gets here they usually aren't
+    void replay(RenderQueue& queue) {
+        for (size_t i = 0; i < mActive; ++i) {
+            CommandBuffer& commands = mBuffers[i];
+            while (!commands.isRecorded()) {
+                std::this_thread::yield();
+            }
+            commands.replay(queue);
+        }
+        mActive = 0;
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include "GLStateCache.h"
+#include "Log.h"
+#include "RenderPass.h"
+
+// Dynamic resolution scaling.
+// The scene is drawn into the lower-left corner of an offscreen target sized for the
+// largest scale, then stretched onto the window with one linear blit, so changing the
+// scale from frame to frame never reallocates anything. The scale follows measured GPU
+// time against the frame budget; pixel cost grows with the square of the scale, so the
+// correction is the square root of how far the frame is over or under budget.
+// The target is its own render pass and is invalidated once the blit has read it.
+class DynamicResolution {
+private:
+    static constexpr float kLowestScale = 0.25f;
+    // Headroom left in the budget for the blit, compositor and measurement noise
+    static constexpr float kBudgetFraction = 0.85f;
+    // Results lag a few frames behind the scale they were measured at, so steps are capped.
+    // Shrinking reacts quickly to throttling, growing back is slow to avoid oscillating.
+    static constexpr float kMaxStepDown = 0.90f;
+    static constexpr float kMaxStepUp = 1.02f;
+    // Changes smaller than this are noise
+    static constexpr float kDeadband = 0.03f;
+
+    GLuint mFramebuffer = 0;
+    GLuint mColorBuffer = 0;
+    RenderPass mPass;
+    float mMinScale = 1.0f;
+    float mMaxScale = 1.0f;
+    float mScaleCap = 1.0f;
+    float mScale = 1.0f;
+    GLsizei mWindowWidth = 0;
+    GLsizei mWindowHeight = 0;
+    GLsizei mSceneWidth = 0;
+    GLsizei mSceneHeight = 0;
+
+    [[nodiscard]]
+    float upperScale() const {
+        return std::max(mMinScale, std::min(mMaxScale, mScaleCap));
+    }
+
+    void updateSceneSize() {
+        mSceneWidth = std::max<GLsizei>(1, static_cast<GLsizei>(std::lround(mWindowWidth * mScale)));
+        mSceneHeight = std::max<GLsizei>(1, static_cast<GLsizei>(std::lround(mWindowHeight * mScale)));
+    }
+
+public:
+    DynamicResolution() = default;
+    ~DynamicResolution() {
+        cleanup();
+    }
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // "min,max" such as "0.5,1"; a single value is a fixed scale
+    static bool limitsFromString(const char* value, float& minScale, float& maxScale) {
+        char* end = nullptr;
+        float first = strtof(value, &end);
+        if (end == value) {
+            return false;
+        }
+        float second = *end == ',' ? strtof(end + 1, nullptr) : first;
+        minScale = std::min(first, second);
+        maxScale = std::max(first, second);
+        return true;
+    }
+
+    // Scales are clamped to [0.25, 1]; the scene starts at the largest one
+    void setLimits(float minScale, float maxScale) {
+        mMaxScale = std::clamp(maxScale, kLowestScale, 1.0f);
+        mMinScale = std::clamp(minScale, kLowestScale, mMaxScale);
+        mScale = mMaxScale;
+        LOG_INFO("Resolution scale %.2f to %.2f", mMinScale, mMaxScale);
+    }
+
+    void setClearColor(float r, float g, float b, float a) {
+        mPass.setClearColor(r, g, b, a);
+    }
+
+    // Lowers the largest scale without touching the limits, e.g. under thermal pressure
+    void setScaleCap(float cap) {
+        mScaleCap = cap;
+        mScale = std::min(mScale, upperScale());
+        updateSceneSize();
+    }
+
+    [[nodiscard]]
+    bool isEnabled() const {
+        return mMinScale < 1.0f;
+    }
+
+    // Must be called with a current context whenever the window size changes
+    bool resize(GLsizei windowWidth, GLsizei windowHeight) {
+        mWindowWidth = windowWidth;
+        mWindowHeight = windowHeight;
+        updateSceneSize();
+        if (!isEnabled()) {
+            return true;
+        }
+
+        if (!mFramebuffer) {
+            glGenFramebuffers(1, &mFramebuffer);
+            glGenRenderbuffers(1, &mColorBuffer);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8,
+                              std::max<GLsizei>(1, static_cast<GLsizei>(std::ceil(windowWidth * mMaxScale))),
+                              std::max<GLsizei>(1, static_cast<GLsizei>(std::ceil(windowHeight * mMaxScale))));
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorBuffer);
+        mPass.setFramebuffer(mFramebuffer, RenderPass::kColor);
+        mPass.setStored(0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            LOG_ERROR("Scaled scene framebuffer incomplete, drawing at full resolution");
+            cleanup();
+            mMinScale = 1.0f;
+            mMaxScale = 1.0f;
+            mScale = 1.0f;
+            updateSceneSize();
+        }
+        return complete;
+    }
+
+    // Steers the scale towards the budget with one GPU result; call once per new result
+    void update(int64_t gpuTimeNs, int64_t budgetNs) {
+        if (!isEnabled() || gpuTimeNs <= 0 || budgetNs <= 0) {
+            return;
+        }
+        float ratio = kBudgetFraction * static_cast<float>(budgetNs) / static_cast<float>(gpuTimeNs);
+        float correction = std::sqrt(ratio);
+        if (std::fabs(correction - 1.0f) < kDeadband) {
+            return;
+        }
+        mScale = std::clamp(mScale * std::clamp(correction, kMaxStepDown, kMaxStepUp), mMinScale, upperScale());
+        updateSceneSize();
+    }
+
+    // Redirects drawing into the offscreen target at the current scale
+    void beginScene() const {
+        if (!mFramebuffer) {
+            return;
+        }
+        mPass.begin();
+        GLStateCache::current().viewport(0, 0, mSceneWidth, mSceneHeight);
+    }
+
+    // Upscales the scene onto the window and leaves the window bound for overlays.
+    // Blits honour the scissor test, so callers must not leave it enabled.
+    // Nothing reads the target after the blit, so its tiles are never written back.
+    void endScene() const {
+        if (!mFramebuffer) {
+            return;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, mSceneWidth, mSceneHeight, 0, 0, mWindowWidth, mWindowHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        mPass.end();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLStateCache::current().viewport(0, 0, mWindowWidth, mWindowHeight);
+    }
+
+    [[nodiscard]]
+    float scale() const {
+        return mScale;
+    }
+
+    void cleanup() {
+        if (mFramebuffer) {
+            glDeleteFramebuffers(1, &mFramebuffer);
+            mFramebuffer = 0;
+        }
+        if (mColorBuffer) {
+            glDeleteRenderbuffers(1, &mColorBuffer);
+            mColorBuffer = 0;
+        }
+    }
+
+    // The target dies with its context; resize() recreates it
+    void invalidate() {
+        mFramebuffer = 0;
+        mColorBuffer = 0;
+    }
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <climits>
+#include <cstdlib>
+#include <vector>
+
+// Buffers the window pass needs from an EGL config
+struct EGLConfigRequest {
+    EGLint surfaceType = EGL_WINDOW_BIT;
+    EGLint redSize = 8;
+    EGLint greenSize = 8;
+    EGLint blueSize = 8;
+    EGLint depthSize = 0;
+    EGLint stencilSize = 0;
+    EGLint samples = 0;
+};
+
+inline EGLint eglConfigAttrib(EGLDisplay display, EGLConfig config, EGLint attribute) {
+    EGLint value = 0;
+    eglGetConfigAttrib(display, config, attribute, &value);
+    return value;
+}
+
+// Lower is closer to the request. Every surplus bit is bandwidth nobody uses, so any
+// difference costs; alpha is never asked for, and a different MSAA count costs most.
+inline int scoreEGLConfig(EGLDisplay display, EGLConfig config, const EGLConfigRequest& request) {
+    int score = 0;
+    score += 4 * abs(eglConfigAttrib(display, config, EGL_RED_SIZE) - request.redSize);
+    score += 4 * abs(eglConfigAttrib(display, config, EGL_GREEN_SIZE) - request.greenSize);
+    score += 4 * abs(eglConfigAttrib(display, config, EGL_BLUE_SIZE) - request.blueSize);
+    score += 4 * eglConfigAttrib(display, config, EGL_ALPHA_SIZE);
+    score += 2 * abs(eglConfigAttrib(display, config, EGL_DEPTH_SIZE) - request.depthSize);
+    score += 2 * abs(eglConfigAttrib(display, config, EGL_STENCIL_SIZE) - request.stencilSize);
+    score += 16 * abs(eglConfigAttrib(display, config, EGL_SAMPLES) - request.samples);
+    // Slow or non-conformant configs only win when nothing else matches
+    if (eglConfigAttrib(display, config, EGL_CONFIG_CAVEAT) != EGL_NONE) {
+        score += 1000;
+    }
+    return score;
+}
+
+// eglChooseConfig only applies the request as minimums and sorts deeper colour first,
+// so every matching config is scored instead of taking the first one
+inline bool chooseEGLConfig(EGLDisplay display, const EGLConfigRequest& request, EGLConfig& chosen) {
+    const EGLint attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_SURFACE_TYPE, request.surfaceType,
+        EGL_RED_SIZE, request.redSize,
+        EGL_GREEN_SIZE, request.greenSize,
+        EGL_BLUE_SIZE, request.blueSize,
+        EGL_DEPTH_SIZE, request.depthSize,
+        EGL_STENCIL_SIZE, request.stencilSize,
+        EGL_SAMPLE_BUFFERS, request.samples > 0 ? 1 : 0,
+        EGL_SAMPLES, request.samples,
+        EGL_NONE
+    };
+
+    EGLint count = 0;
+    if (!eglChooseConfig(display, attribs, nullptr, 0, &count) || count == 0) {
+        return false;
+    }
+    std::vector<EGLConfig> configs(static_cast<size_t>(count));
+    if (!eglChooseConfig(display, attribs, configs.data(), count, &count) || count == 0) {
+        return false;
+    }
+
+    int bestScore = INT_MAX;
+    for (EGLint i = 0; i < count; ++i) {
+        int score = scoreEGLConfig(display, configs[i], request);
+        if (score < bestScore) {
+            bestScore = score;
+            chosen = configs[i];
+        }
+    }
+    return true;
+}
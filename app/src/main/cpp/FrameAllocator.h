@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "Log.h"
+
+// Bump allocator over one fixed block, safe to allocate from several threads at once.
+// Nothing is freed individually; reset() drops everything. Only trivially destructible
+// types belong in here, since no destructor ever runs.
+class LinearAllocator {
+private:
+    std::unique_ptr<uint8_t[]> mBlock;
+    size_t mCapacity = 0;
+    std::atomic<size_t> mOffset{0};
+    std::atomic<uint32_t> mFailures{0};
+
+public:
+    LinearAllocator() = default;
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    void initialize(size_t capacity) {
+        mBlock = std::make_unique<uint8_t[]>(capacity);
+        mCapacity = capacity;
+        reset();
+    }
+
+    // Returns nullptr once the block is exhausted
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        // Over-reserve by the alignment so the bump itself stays a single atomic add
+        size_t start = mOffset.fetch_add(size + alignment - 1, std::memory_order_relaxed);
+        auto base = reinterpret_cast<uintptr_t>(mBlock.get());
+        uintptr_t aligned = (base + start + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        if (aligned + size > base + mCapacity) {
+            mFailures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena memory is never destructed");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void reset() {
+        mOffset.store(0, std::memory_order_relaxed);
+        mFailures.store(0, std::memory_order_relaxed);
+    }
+
+    // Bytes handed out so far, clamped to the block for failed allocations
+    [[nodiscard]]
+    size_t used() const {
+        size_t offset = mOffset.load(std::memory_order_relaxed);
+        return offset < mCapacity ? offset : mCapacity;
+    }
+
+    [[nodiscard]]
+    size_t capacity() const {
+        return mCapacity;
+    }
+
+    [[nodiscard]]
+    uint32_t failures() const {
+        return mFailures.load(std::memory_order_relaxed);
+    }
+};
+
+// One LinearAllocator per frame in flight.
+// Data recorded for a frame stays valid until the same arena comes round again
+// kFramesInFlight frames later, by which point the frame that used it has been submitted.
+class FrameAllocator {
+public:
+    static constexpr size_t kFramesInFlight = 3;
+
+    struct Stats {
+        size_t capacity = 0;   // Per frame
+        size_t highWater = 0;  // Most any frame used since initialize()
+        uint32_t failures = 0; // Allocations that didn't fit, since initialize()
+    };
+
+private:
+    LinearAllocator mArenas[kFramesInFlight];
+    size_t mFrame = 0;
+    Stats mStats;
+
+public:
+    void initialize(size_t bytesPerFrame) {
+        for (LinearAllocator& arena : mArenas) {
+            arena.initialize(bytesPerFrame);
+        }
+        mStats = {bytesPerFrame, 0, 0};
+    }
+
+    // Owner thread only, with no allocations from the previous use of the next arena still running
+    void beginFrame() {
+        LinearAllocator& finished = mArenas[mFrame];
+        if (finished.used() > mStats.highWater) {
+            mStats.highWater = finished.used();
+        }
+        if (finished.failures() > 0) {
+            if (mStats.failures == 0) {
+                LOG_ERROR("Frame arena of %zu bytes exhausted, raise its size", mStats.capacity);
+            }
+            mStats.failures += finished.failures();
+        }
+
+        mFrame = (mFrame + 1) % kFramesInFlight;
+        mArenas[mFrame].reset();
+    }
+
+    template <typename T>
+    T* allocate(size_t count) {
+        return mArenas[mFrame].allocate<T>(count);
+    }
+
+    [[nodiscard]]
+    Stats stats() const {
+        return mStats;
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <android/choreographer.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <dlfcn.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include "Log.h"
+
+// Target presentation rate for the pacer
+enum class FrameRate {
+    Native,   // Every vsync of the panel
+    Half,     // Every other vsync of the panel
+    Fixed30,  // Closest vsync multiple to 30 Hz
+    Fixed60   // Closest vsync multiple to 60 Hz
+};
+
+// Choreographer-driven frame pacing.
+// The Choreographer entry points are resolved at runtime because minSdk is 21:
+// AChoreographer_postFrameCallback64 needs API 29, AChoreographer_postFrameCallback
+// API 24, and below that the pacer falls back to eglSwapInterval.
+// A posted callback cannot be cancelled, so the pacer must outlive the looper it runs on.
+class FramePacer {
+private:
+    using GetInstanceFn = AChoreographer* (*)();
+    using PostFrameCallbackFn = void (*)(AChoreographer*, AChoreographer_frameCallback, void*);
+    using PostFrameCallback64Fn = void (*)(AChoreographer*, AChoreographer_frameCallback64, void*);
+    using RegisterRefreshRateCallbackFn = void (*)(AChoreographer*, AChoreographer_refreshRateCallback, void*);
+
+    static constexpr int64_t kDefaultVsyncPeriodNs = 16666667;
+    static constexpr int64_t kMinVsyncPeriodNs = 4000000;   // 250 Hz
+    static constexpr int64_t kMaxVsyncPeriodNs = 50000000;  // 20 Hz
+
+    AChoreographer* mChoreographer = nullptr;
+    PostFrameCallbackFn mPostFrameCallback = nullptr;
+    PostFrameCallback64Fn mPostFrameCallback64 = nullptr;
+    PFNEGLPRESENTATIONTIMEANDROIDPROC mPresentationTime = nullptr;
+
+    FrameRate mFrameRate = FrameRate::Native;
+    bool mThrottled = false;
+    int mAppliedSwapInterval = 0;
+    int64_t mVsyncPeriodNs = kDefaultVsyncPeriodNs;
+    bool mHasRefreshRateCallback = false;
+    int64_t mLastVsyncNs = 0;
+    int64_t mLastFrameVsyncNs = 0;
+    int64_t mFrameTimeNs = 0;
+    bool mRunning = false;
+    bool mCallbackPosted = false;
+    bool mFramePending = false;
+
+    static int64_t nowNanos() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    static void onFrameCallback64(int64_t frameTimeNanos, void* data) {
+        static_cast<FramePacer*>(data)->onVsync(frameTimeNanos);
+    }
+
+    static void onFrameCallback(long frameTimeNanos, void* data) {
+        // The legacy callback truncates the timestamp to 32 bits on 32-bit ABIs
+        int64_t frameTime = sizeof(long) < sizeof(int64_t) ? nowNanos() : static_cast<int64_t>(frameTimeNanos);
+        static_cast<FramePacer*>(data)->onVsync(frameTime);
+    }
+
+    static void onRefreshRateChanged(int64_t vsyncPeriodNanos, void* data) {
+        auto* pacer = static_cast<FramePacer*>(data);
+        pacer->mVsyncPeriodNs = vsyncPeriodNanos;
+        pacer->mHasRefreshRateCallback = true;
+        LOG_INFO("Display refresh period changed to %.2f ms", vsyncPeriodNanos / 1e6);
+    }
+
+    void postCallback() {
+        if (mCallbackPosted) {
+            return;
+        }
+        if (mPostFrameCallback64) {
+            mPostFrameCallback64(mChoreographer, onFrameCallback64, this);
+        } else {
+            mPostFrameCallback(mChoreographer, onFrameCallback, this);
+        }
+        mCallbackPosted = true;
+    }
+
+    void onVsync(int64_t frameTimeNanos) {
+        mCallbackPosted = false;
+
+        // Without a refresh rate callback, track the panel period from consecutive vsyncs
+        if (!mHasRefreshRateCallback && mLastVsyncNs != 0) {
+            int64_t delta = frameTimeNanos - mLastVsyncNs;
+            if (delta >= kMinVsyncPeriodNs && delta <= kMaxVsyncPeriodNs) {
+                mVsyncPeriodNs += (delta - mVsyncPeriodNs) / 8;
+            }
+        }
+        mLastVsyncNs = frameTimeNanos;
+
+        int64_t interval = swapInterval() * mVsyncPeriodNs;
+        if (!mFramePending && frameTimeNanos - mLastFrameVsyncNs >= interval - mVsyncPeriodNs / 2) {
+            mFramePending = true;
+            mFrameTimeNs = frameTimeNanos;
+            mLastFrameVsyncNs = frameTimeNanos;
+        }
+
+        if (mRunning) {
+            postCallback();
+        }
+    }
+
+    [[nodiscard]]
+    int64_t targetPeriodNs() const {
+        switch (mFrameRate) {
+            case FrameRate::Half: return 2 * mVsyncPeriodNs;
+            case FrameRate::Fixed30: return 33333333;
+            case FrameRate::Fixed60: return 16666667;
+            default: return mVsyncPeriodNs;
+        }
+    }
+
+public:
+    FramePacer() = default;
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // Must be called on a thread with an ALooper; callbacks are dispatched from its poll
+    void initialize() {
+        void* lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (!lib) {
+            LOG_INFO("libandroid.so not available, pacing with eglSwapInterval");
+            return;
+        }
+
+        auto getInstance = reinterpret_cast<GetInstanceFn>(dlsym(lib, "AChoreographer_getInstance"));
+        mPostFrameCallback64 = reinterpret_cast<PostFrameCallback64Fn>(dlsym(lib, "AChoreographer_postFrameCallback64"));
+        mPostFrameCallback = reinterpret_cast<PostFrameCallbackFn>(dlsym(lib, "AChoreographer_postFrameCallback"));
+        auto registerRefreshRate = reinterpret_cast<RegisterRefreshRateCallbackFn>(
+                dlsym(lib, "AChoreographer_registerRefreshRateCallback"));
+
+        if (getInstance && (mPostFrameCallback64 || mPostFrameCallback)) {
+            mChoreographer = getInstance();
+        }
+
+        if (!mChoreographer) {
+            mPostFrameCallback64 = nullptr;
+            mPostFrameCallback = nullptr;
+            LOG_INFO("Choreographer not available, pacing with eglSwapInterval");
+            return;
+        }
+
+        if (registerRefreshRate) {
+            registerRefreshRate(mChoreographer, onRefreshRateChanged, this);
+        }
+        LOG_INFO("Frame pacing driven by Choreographer");
+    }
+
+    // Configure a freshly created surface for the current pacing mode
+    void attachSurface(EGLDisplay display) {
+        const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (extensions && strstr(extensions, "EGL_ANDROID_presentation_time")) {
+            mPresentationTime = reinterpret_cast<PFNEGLPRESENTATIONTIMEANDROIDPROC>(
+                    eglGetProcAddress("eglPresentationTimeANDROID"));
+        }
+
+        // Choreographer skips vsyncs itself, the swap only has to wait for the next one
+        mAppliedSwapInterval = usesChoreographer() ? 1 : swapInterval();
+        eglSwapInterval(display, mAppliedSwapInterval);
+    }
+
+    void setFrameRate(FrameRate rate) {
+        mFrameRate = rate;
+    }
+
+    // Halves whatever rate was chosen, e.g. while the device is thermally throttled
+    void setThrottled(bool throttled) {
+        if (throttled != mThrottled) {
+            LOG_INFO("Frame rate %s", throttled ? "halved" : "restored");
+        }
+        mThrottled = throttled;
+    }
+
+    static FrameRate frameRateFromString(const char* value) {
+        if (strcmp(value, "half") == 0) {
+            return FrameRate::Half;
+        }
+        if (strcmp(value, "30") == 0) {
+            return FrameRate::Fixed30;
+        }
+        if (strcmp(value, "60") == 0) {
+            return FrameRate::Fixed60;
+        }
+        return FrameRate::Native;
+    }
+
+    void start() {
+        if (mRunning) {
+            return;
+        }
+        mRunning = true;
+        if (usesChoreographer()) {
+            postCallback();
+        }
+    }
+
+    void stop() {
+        mRunning = false;
+        mFramePending = false;
+    }
+
+    [[nodiscard]]
+    bool usesChoreographer() const {
+        return mChoreographer != nullptr;
+    }
+
+    // Number of panel vsyncs each frame should stay on screen
+    [[nodiscard]]
+    int swapInterval() const {
+        auto vsyncs = static_cast<int>(std::lround(static_cast<double>(targetPeriodNs()) / mVsyncPeriodNs));
+        return (vsyncs < 1 ? 1 : vsyncs) * (mThrottled ? 2 : 1);
+    }
+
+    // Expected time between presented frames at the current rate
+    [[nodiscard]]
+    int64_t framePeriodNs() const {
+        return swapInterval() * mVsyncPeriodNs;
+    }
+
+    [[nodiscard]]
+    bool isFrameDue() const {
+        return mRunning && (!usesChoreographer() || mFramePending);
+    }
+
+    // Call right before presenting a frame started by isFrameDue() without EGL, e.g. with Vulkan
+    void beforePresent() {
+        mFramePending = false;
+    }
+
+    // Call right before eglSwapBuffers for a frame started by isFrameDue()
+    void beforeSwap(EGLDisplay display, EGLSurface surface) {
+        int64_t frameTime = usesChoreographer() ? mFrameTimeNs : nowNanos();
+        mFramePending = false;
+
+        // Without Choreographer a rate change only takes effect through the swap interval
+        if (!usesChoreographer() && swapInterval() != mAppliedSwapInterval) {
+            mAppliedSwapInterval = swapInterval();
+            eglSwapInterval(display, mAppliedSwapInterval);
+        }
+
+        if (mPresentationTime) {
+            // Half a period short of the target vsync so the frame latches exactly on it
+            int64_t presentTime = frameTime + swapInterval() * mVsyncPeriodNs - mVsyncPeriodNs / 2;
+            mPresentationTime(display, surface, presentTime);
+        }
+    }
+};
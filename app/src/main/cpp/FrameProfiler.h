@@ -0,0 +1,381 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <vector>
+
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "Log.h"
+#include "SurfaceDamage.h"
+
+// Frame timing instrumentation.
+// CPU time is taken with CLOCK_MONOTONIC around each phase of a frame, GPU time with
+// GL_EXT_disjoint_timer_query queries kept in a ring so results are only read once
+// the driver reports them available. Phases are also emitted as ATrace sections so
+// they show up in Perfetto/systrace captures.
+class FrameProfiler {
+public:
+    enum class Phase {
+        Clear,
+        Draw,
+        Hud,
+        Swap,
+        Count
+    };
+
+private:
+    using ATraceBeginSectionFn = void (*)(const char*);
+    using ATraceEndSectionFn = void (*)();
+    using ATraceIsEnabledFn = bool (*)();
+
+    static constexpr size_t kPhaseCount = static_cast<size_t>(Phase::Count);
+    static constexpr const char* kPhaseNames[kPhaseCount] = {"Clear", "Draw", "Hud", "Swap"};
+    static constexpr size_t kQueryCount = 4;
+    static constexpr size_t kHistorySize = 120;
+    static constexpr int64_t kSummaryIntervalNs = 5000000000LL;
+
+    ATraceBeginSectionFn mTraceBegin = nullptr;
+    ATraceEndSectionFn mTraceEnd = nullptr;
+    ATraceIsEnabledFn mTraceIsEnabled = nullptr;
+
+    PFNGLGETQUERYOBJECTUI64VEXTPROC mGetQueryObjectui64v = nullptr;
+    GLuint mQueries[kQueryCount] = {};
+    bool mQueryPending[kQueryCount] = {};
+    size_t mQueryIndex = 0;
+    bool mQueryActive = false;
+    int64_t mLatestGpuTimeNs = 0;
+    bool mLatestGpuTimeTaken = true;
+
+    int64_t mTargetPeriodNs = 16666667;
+    int64_t mFrameStartNs = 0;
+    int64_t mLastFrameStartNs = 0;
+    int64_t mPhaseStartNs[kPhaseCount] = {};
+    int64_t mPhaseTimeNs[kPhaseCount] = {};
+
+    // Frame-to-frame intervals for the overlay
+    int64_t mHistory[kHistorySize] = {};
+    size_t mHistoryIndex = 0;
+
+    // Samples collected since the last logcat summary
+    std::vector<int64_t> mFrameTimes;
+    std::vector<int64_t> mCpuTimes;
+    std::vector<int64_t> mGpuTimes;
+    std::vector<int64_t> mInputLatencies;
+    int64_t mPhaseTotalsNs[kPhaseCount] = {};
+    uint32_t mJankCount = 0;
+    uint64_t mStateCallsIssued = 0;
+    uint64_t mStateCallsSkipped = 0;
+    size_t mArenaHighWater = 0;
+    size_t mArenaCapacity = 0;
+    uint32_t mArenaFailures = 0;
+    size_t mPoolLive = 0;
+    size_t mPoolHighWater = 0;
+    size_t mPoolCapacity = 0;
+    int64_t mSummaryStartNs = 0;
+
+    static int64_t nowNanos() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    static double percentileMs(std::vector<int64_t>& samples, double fraction) {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        auto nth = samples.begin() + static_cast<ptrdiff_t>(fraction * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth / 1e6;
+    }
+
+    [[nodiscard]]
+    bool isTracing() const {
+        return mTraceBegin && (!mTraceIsEnabled || mTraceIsEnabled());
+    }
+
+    // Reads back any finished GPU queries; never waits on one that is still in flight
+    void collectGpuResults() {
+        // Reading the flag clears it, so one read has to cover every query in flight
+        GLint disjoint = GL_FALSE;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            std::fill(std::begin(mQueryPending), std::end(mQueryPending), false);
+            return;
+        }
+
+        // Oldest first, from the slot about to be reused, so the newest result is kept last
+        for (size_t n = 0; n < kQueryCount; ++n) {
+            size_t i = (mQueryIndex + n) % kQueryCount;
+            if (!mQueryPending[i]) {
+                continue;
+            }
+
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(mQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+
+            mQueryPending[i] = false;
+            GLuint64 elapsed = 0;
+            mGetQueryObjectui64v(mQueries[i], GL_QUERY_RESULT, &elapsed);
+            mGpuTimes.push_back(static_cast<int64_t>(elapsed));
+            mLatestGpuTimeNs = static_cast<int64_t>(elapsed);
+            mLatestGpuTimeTaken = false;
+        }
+    }
+
+    void logSummary(int64_t now) {
+        size_t frames = mFrameTimes.size();
+        if (frames > 0) {
+            double frameP50 = percentileMs(mFrameTimes, 0.50);
+            double frameP95 = percentileMs(mFrameTimes, 0.95);
+            double frameP99 = percentileMs(mFrameTimes, 0.99);
+            double cpuP50 = percentileMs(mCpuTimes, 0.50);
+            double gpuP50 = percentileMs(mGpuTimes, 0.50);
+            LOG_INFO("Frame time p50 %.2f ms, p95 %.2f ms, p99 %.2f ms | cpu p50 %.2f ms | gpu p50 %.2f ms | "
+                     "%zu frames, %u janky",
+                     frameP50, frameP95, frameP99, cpuP50, gpuP50, frames, mJankCount);
+
+            for (size_t i = 0; i < kPhaseCount; ++i) {
+                if (mPhaseTotalsNs[i] > 0) {
+                    LOG_INFO("  %s avg %.3f ms", kPhaseNames[i], mPhaseTotalsNs[i] / 1e6 / frames);
+                }
+            }
+            LOG_INFO("  GL state calls per frame: %.1f issued, %.1f filtered",
+                     static_cast<double>(mStateCallsIssued) / frames, static_cast<double>(mStateCallsSkipped) / frames);
+            if (mArenaCapacity > 0) {
+                LOG_INFO("  Frame arena high water %zu of %zu KB, %u failed allocations",
+                         mArenaHighWater / 1024, mArenaCapacity / 1024, mArenaFailures);
+            }
+            if (mPoolCapacity > 0) {
+                LOG_INFO("  Mesh pool high water %zu of %zu, %zu live",
+                         mPoolHighWater, mPoolCapacity, mPoolLive);
+            }
+            if (!mInputLatencies.empty()) {
+                LOG_INFO("  Touch sample age at submission p50 %.2f ms, p95 %.2f ms",
+                         percentileMs(mInputLatencies, 0.50), percentileMs(mInputLatencies, 0.95));
+            }
+        }
+
+        mFrameTimes.clear();
+        mCpuTimes.clear();
+        mGpuTimes.clear();
+        mInputLatencies.clear();
+        std::fill(std::begin(mPhaseTotalsNs), std::end(mPhaseTotalsNs), 0);
+        mJankCount = 0;
+        mStateCallsIssued = 0;
+        mStateCallsSkipped = 0;
+        mSummaryStartNs = now;
+    }
+
+public:
+    FrameProfiler() {
+        mFrameTimes.reserve(1024);
+        mCpuTimes.reserve(1024);
+        mGpuTimes.reserve(1024);
+
+        void* lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (lib) {
+            // API 23+
+            mTraceBegin = reinterpret_cast<ATraceBeginSectionFn>(dlsym(lib, "ATrace_beginSection"));
+            mTraceEnd = reinterpret_cast<ATraceEndSectionFn>(dlsym(lib, "ATrace_endSection"));
+            mTraceIsEnabled = reinterpret_cast<ATraceIsEnabledFn>(dlsym(lib, "ATrace_isEnabled"));
+            if (!mTraceBegin || !mTraceEnd) {
+                mTraceBegin = nullptr;
+                mTraceEnd = nullptr;
+            }
+        }
+    }
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Must be called with a current context
+    void initialize() {
+        invalidate();
+        if (hasGLExtension("GL_EXT_disjoint_timer_query")) {
+            mGetQueryObjectui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+                    eglGetProcAddress("glGetQueryObjectui64vEXT"));
+        }
+
+        if (mGetQueryObjectui64v) {
+            glGenQueries(kQueryCount, mQueries);
+            // Reading the flag resets it, so start from a clean state
+            GLint disjoint;
+            glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        } else {
+            LOG_INFO("GPU timer queries not available");
+        }
+    }
+
+    // Queries die with their context
+    void invalidate() {
+        mGetQueryObjectui64v = nullptr;
+        std::fill(std::begin(mQueries), std::end(mQueries), 0);
+        std::fill(std::begin(mQueryPending), std::end(mQueryPending), false);
+        mQueryActive = false;
+        mLatestGpuTimeTaken = true;
+    }
+
+    // Hands out each GPU frame time once, as soon as it has been read back
+    bool takeLatestGpuTime(int64_t& elapsedNs) {
+        if (mLatestGpuTimeTaken) {
+            return false;
+        }
+        mLatestGpuTimeTaken = true;
+        elapsedNs = mLatestGpuTimeNs;
+        return true;
+    }
+
+    void setTargetPeriod(int64_t periodNs) {
+        mTargetPeriodNs = periodNs;
+    }
+
+    // Frame allocator usage for the summary; the high water is since the allocator was created
+    void setArenaUsage(size_t highWater, size_t capacity, uint32_t failures) {
+        mArenaHighWater = highWater;
+        mArenaCapacity = capacity;
+        mArenaFailures = failures;
+    }
+
+    // Mesh pool usage for the summary; the high water is since the pool was created
+    void setPoolUsage(size_t live, size_t highWater, size_t capacity) {
+        mPoolLive = live;
+        mPoolHighWater = highWater;
+        mPoolCapacity = capacity;
+    }
+
+    // Time from a touch event to the submission that drew it
+    void addInputLatency(int64_t latencyNs) {
+        mInputLatencies.push_back(latencyNs);
+    }
+
+    // Label for ad-hoc sections outside the fixed frame phases
+    void beginSection(const char* name) const {
+        if (isTracing()) {
+            mTraceBegin(name);
+        }
+    }
+
+    void endSection() const {
+        if (isTracing()) {
+            mTraceEnd();
+        }
+    }
+
+    void beginFrame() {
+        mFrameStartNs = nowNanos();
+        beginSection("Frame");
+
+        if (mGetQueryObjectui64v) {
+            collectGpuResults();
+            // Skip GPU timing for this frame rather than wait on the slot's previous query
+            if (!mQueryPending[mQueryIndex]) {
+                glBeginQuery(GL_TIME_ELAPSED_EXT, mQueries[mQueryIndex]);
+                mQueryActive = true;
+            }
+        }
+    }
+
+    void beginPhase(Phase phase) {
+        mPhaseStartNs[static_cast<size_t>(phase)] = nowNanos();
+        beginSection(kPhaseNames[static_cast<size_t>(phase)]);
+    }
+
+    void endPhase(Phase phase) {
+        auto index = static_cast<size_t>(phase);
+        endSection();
+        mPhaseTimeNs[index] = nowNanos() - mPhaseStartNs[index];
+        mPhaseTotalsNs[index] += mPhaseTimeNs[index];
+    }
+
+    // Closes the GPU timer once all of the frame's GL work has been issued, before the swap
+    void endGpuWork() {
+        if (mQueryActive) {
+            glEndQuery(GL_TIME_ELAPSED_EXT);
+            mQueryPending[mQueryIndex] = true;
+            mQueryIndex = (mQueryIndex + 1) % kQueryCount;
+            mQueryActive = false;
+        }
+    }
+
+    void endFrame() {
+        endSection();
+        int64_t now = nowNanos();
+
+        GLStateCache::Counters stateCounters = GLStateCache::current().takeCounters();
+        mStateCallsIssued += stateCounters.issued;
+        mStateCallsSkipped += stateCounters.skipped;
+        mCpuTimes.push_back(now - mFrameStartNs);
+
+        if (mLastFrameStartNs != 0) {
+            int64_t interval = mFrameStartNs - mLastFrameStartNs;
+            // Long gaps are pauses, not frames
+            if (interval < kSummaryIntervalNs) {
+                mFrameTimes.push_back(interval);
+                mHistory[mHistoryIndex] = interval;
+                mHistoryIndex = (mHistoryIndex + 1) % kHistorySize;
+                if (interval > mTargetPeriodNs + mTargetPeriodNs / 2) {
+                    ++mJankCount;
+                }
+            }
+        }
+        mLastFrameStartNs = mFrameStartNs;
+
+        if (mSummaryStartNs == 0) {
+            mSummaryStartNs = now;
+        } else if (now - mSummaryStartNs >= kSummaryIntervalNs) {
+            logSummary(now);
+        }
+    }
+
+    // Where drawHud() draws for a window of this size
+    [[nodiscard]]
+    DamageRect hudRect(int32_t width, int32_t height) const {
+        const int32_t barWidth = std::max<int32_t>(1, width / 3 / static_cast<int32_t>(kHistorySize));
+        return {8, 8, barWidth * static_cast<int32_t>(kHistorySize), height / 5};
+    }
+
+    // Bar graph of recent frame times along the bottom edge, drawn with scissored clears.
+    // Green bars are on target, red ones janked; the white line is the target period.
+    // Leaves the scissor test off.
+    void drawHud(int32_t width, int32_t height) const {
+        const DamageRect area = hudRect(width, height);
+        const int32_t barWidth = area.width / static_cast<int32_t>(kHistorySize);
+        const int32_t graphHeight = area.height;
+        const int32_t left = area.x;
+        const int32_t bottom = area.y;
+        const double scale = graphHeight / (2.0 * mTargetPeriodNs);
+
+        GLStateCache& state = GLStateCache::current();
+        state.setScissorTest(true);
+        glScissor(left, bottom, barWidth * static_cast<int32_t>(kHistorySize), graphHeight);
+        state.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        for (size_t i = 0; i < kHistorySize; ++i) {
+            int64_t frameTime = mHistory[(mHistoryIndex + i) % kHistorySize];
+            if (frameTime == 0) {
+                continue;
+            }
+            auto barHeight = static_cast<int32_t>(std::min<double>(graphHeight, frameTime * scale));
+            bool janky = frameTime > mTargetPeriodNs + mTargetPeriodNs / 2;
+            glScissor(left + static_cast<int32_t>(i) * barWidth, bottom, barWidth, barHeight);
+            state.clearColor(janky ? 1.0f : 0.0f, janky ? 0.0f : 0.8f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        glScissor(left, bottom + graphHeight / 2, barWidth * static_cast<int32_t>(kHistorySize), 1);
+        state.clearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        state.setScissorTest(false);
+    }
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bounding spheres in structure-of-arrays form, so a SIMD kernel loads four of a kind at once
+struct BoundsSoA {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void push(float centerX, float centerY, float centerZ, float sphereRadius) {
+        x.push_back(centerX);
+        y.push_back(centerY);
+        z.push_back(centerZ);
+        radius.push_back(sphereRadius);
+    }
+
+    [[nodiscard]]
+    size_t size() const {
+        return x.size();
+    }
+};
+
+// Tests bounding spheres against the six planes of a view-projection frustum.
+// The SIMD kernel is NEON on arm64-v8a and armeabi-v7a and SSE2 on x86 and x86_64,
+// picked at compile time; the kernel in use can still be switched to the scalar
+// loop or off entirely at runtime to compare them.
+class FrustumCuller {
+public:
+    enum class Kernel {
+        Simd,
+        Scalar,
+        Disabled  // Everything is visible
+    };
+
+#if defined(__ARM_NEON)
+    static constexpr const char* kSimdName = "neon";
+#elif defined(__SSE2__)
+    static constexpr const char* kSimdName = "sse2";
+#else
+    static constexpr const char* kSimdName = "scalar";
+#endif
+
+private:
+    static constexpr size_t kPlaneCount = 6;
+
+    // a, b, c, d of each plane with the normal pointing inwards, normalized
+    float mPlanes[kPlaneCount][4] = {};
+    Kernel mKernel = Kernel::Simd;
+
+    uint32_t cullScalar(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) const {
+        uint32_t count = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+            bool inside = true;
+            for (const float* plane : mPlanes) {
+                float distance = plane[0] * bounds.x[i] + plane[1] * bounds.y[i] + plane[2] * bounds.z[i] + plane[3];
+                inside &= distance > -bounds.radius[i];
+            }
+            visible[count] = i;
+            count += inside ? 1 : 0;
+        }
+        return count;
+    }
+
+    uint32_t cullSimd(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) const {
+        uint32_t count = 0;
+        uint32_t i = begin;
+#if defined(__ARM_NEON)
+        for (; i + 4 <= end; i += 4) {
+            float32x4_t x = vld1q_f32(&bounds.x[i]);
+            float32x4_t y = vld1q_f32(&bounds.y[i]);
+            float32x4_t z = vld1q_f32(&bounds.z[i]);
+            float32x4_t negativeRadius = vnegq_f32(vld1q_f32(&bounds.radius[i]));
+            uint32x4_t inside = vdupq_n_u32(~0u);
+            for (const float* plane : mPlanes) {
+                // Only multiply-accumulate forms that armeabi-v7a NEON also has
+                float32x4_t distance = vdupq_n_f32(plane[3]);
+                distance = vmlaq_n_f32(distance, x, plane[0]);
+                distance = vmlaq_n_f32(distance, y, plane[1]);
+                distance = vmlaq_n_f32(distance, z, plane[2]);
+                inside = vandq_u32(inside, vcgtq_f32(distance, negativeRadius));
+            }
+            uint32_t lanes[4];
+            vst1q_u32(lanes, inside);
+            for (uint32_t lane = 0; lane < 4; ++lane) {
+                visible[count] = i + lane;
+                count += lanes[lane] & 1;
+            }
+        }
+#elif defined(__SSE2__)
+        for (; i + 4 <= end; i += 4) {
+            __m128 x = _mm_loadu_ps(&bounds.x[i]);
+            __m128 y = _mm_loadu_ps(&bounds.y[i]);
+            __m128 z = _mm_loadu_ps(&bounds.z[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const float* plane : mPlanes) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_set1_ps(plane[3]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane[1])));
+                distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane[2])));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (uint32_t lane = 0; lane < 4; ++lane) {
+                visible[count] = i + lane;
+                count += (mask >> lane) & 1;
+            }
+        }
+#endif
+        // Remainder that doesn't fill a register
+        return count + cullScalar(bounds, i, end, visible + count);
+    }
+
+public:
+    static Kernel kernelFromString(const char* value) {
+        if (strcmp(value, "scalar") == 0) {
+            return Kernel::Scalar;
+        }
+        if (strcmp(value, "off") == 0) {
+            return Kernel::Disabled;
+        }
+        return Kernel::Simd;
+    }
+
+    static const char* kernelName(Kernel kernel) {
+        switch (kernel) {
+            case Kernel::Simd: return kSimdName;
+            case Kernel::Scalar: return "scalar";
+            case Kernel::Disabled: return "off";
+        }
+        return "unknown";
+    }
+
+    void setKernel(Kernel kernel) {
+        mKernel = kernel;
+    }
+
+    [[nodiscard]]
+    Kernel kernel() const {
+        return mKernel;
+    }
+
+    // Extracts the planes from a column-major view-projection matrix (Gribb-Hartmann)
+    void setViewProjection(const float* matrix) {
+        auto row = [matrix](int r, int c) { return matrix[c * 4 + r]; };
+        for (size_t i = 0; i < kPlaneCount; ++i) {
+            int axis = static_cast<int>(i / 2);
+            float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+            float* plane = mPlanes[i];
+            for (int c = 0; c < 4; ++c) {
+                plane[c] = row(3, c) + sign * row(axis, c);
+            }
+            float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            if (length > 0.0f) {
+                for (int c = 0; c < 4; ++c) {
+                    plane[c] /= length;
+                }
+            }
+        }
+    }
+
+    // The six planes as a, b, c, d each, e.g. for culling on the GPU
+    [[nodiscard]]
+    const float* planes() const {
+        return &mPlanes[0][0];
+    }
+
+    // Writes the indices in [begin, end) that may be visible to visible, which needs room
+    // for end - begin entries, and returns how many there are. Safe to call from several
+    // threads at once on disjoint ranges.
+    uint32_t cull(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) const {
+        switch (mKernel) {
+            case Kernel::Simd:
+                return cullSimd(bounds, begin, end, visible);
+            case Kernel::Scalar:
+                return cullScalar(bounds, begin, end, visible);
+            case Kernel::Disabled:
+                break;
+        }
+        for (uint32_t i = begin; i < end; ++i) {
+            visible[i - begin] = i;
+        }
+        return end - begin;
+    }
+};
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <GLES3/gl31.h>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+// Shadow copy of the GL binding and fixed-function state, filtering out calls that
+// would not change anything. GL state belongs to the context current on a thread,
+// so there is one cache per thread, reached through current().
+// Every bind in the renderer has to go through here or the shadow copy goes stale;
+// deleting an object that may be bound must be reported with the matching on*Deleted().
+class GLStateCache {
+public:
+    struct Counters {
+        uint32_t issued = 0;
+        uint32_t skipped = 0;
+    };
+
+private:
+    static constexpr GLuint kUnknown = ~0u;
+    static constexpr GLuint kMaxTextureUnits = 16;
+
+    enum BufferSlot {
+        ArrayBuffer,
+        ElementArrayBuffer,
+        UniformBuffer,
+        ShaderStorageBuffer,
+        DrawIndirectBuffer,
+        DispatchIndirectBuffer,
+        PixelUnpackBuffer,
+        CopyReadBuffer,
+        CopyWriteBuffer,
+        BufferSlotCount
+    };
+
+    enum TextureSlot {
+        Texture2D,
+        Texture2DArray,
+        TextureCubeMap,
+        TextureSlotCount
+    };
+
+    GLuint mProgram = kUnknown;
+    GLuint mVertexArray = kUnknown;
+    GLuint mBuffers[BufferSlotCount] = {};
+    GLuint mTextures[kMaxTextureUnits][TextureSlotCount] = {};
+    GLuint mActiveTexture = kUnknown;
+
+    // Tri-state flags: kUnknown, GL_FALSE or GL_TRUE
+    GLuint mBlend = kUnknown;
+    GLuint mDepthTest = kUnknown;
+    GLuint mScissorTest = kUnknown;
+    GLuint mCullFace = kUnknown;
+    GLuint mDepthMask = kUnknown;
+    GLenum mBlendSrc = kUnknown;
+    GLenum mBlendDst = kUnknown;
+    GLenum mDepthFunc = kUnknown;
+    float mClearColor[4] = {};
+    bool mClearColorKnown = false;
+    GLint mViewport[4] = {};
+    bool mViewportKnown = false;
+
+    Counters mCounters;
+
+    static int bufferSlot(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER: return ArrayBuffer;
+            case GL_ELEMENT_ARRAY_BUFFER: return ElementArrayBuffer;
+            case GL_UNIFORM_BUFFER: return UniformBuffer;
+            case GL_SHADER_STORAGE_BUFFER: return ShaderStorageBuffer;
+            case GL_DRAW_INDIRECT_BUFFER: return DrawIndirectBuffer;
+            case GL_DISPATCH_INDIRECT_BUFFER: return DispatchIndirectBuffer;
+            case GL_PIXEL_UNPACK_BUFFER: return PixelUnpackBuffer;
+            case GL_COPY_READ_BUFFER: return CopyReadBuffer;
+            case GL_COPY_WRITE_BUFFER: return CopyWriteBuffer;
+            default: return -1;
+        }
+    }
+
+    static int textureSlot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return Texture2D;
+            case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+            case GL_TEXTURE_CUBE_MAP: return TextureCubeMap;
+            default: return -1;
+        }
+    }
+
+    // Returns true when the call has to be issued, and records it either way
+    bool update(GLuint& cached, GLuint value) {
+        if (cached == value) {
+            ++mCounters.skipped;
+            return false;
+        }
+        cached = value;
+        ++mCounters.issued;
+        return true;
+    }
+
+    void setCapability(GLuint& cached, GLenum capability, bool enabled) {
+        if (update(cached, enabled ? GL_TRUE : GL_FALSE)) {
+            if (enabled) {
+                glEnable(capability);
+            } else {
+                glDisable(capability);
+            }
+        }
+    }
+
+public:
+    GLStateCache() {
+        reset();
+    }
+
+    static GLStateCache& current() {
+        static thread_local GLStateCache cache;
+        return cache;
+    }
+
+    // Forget everything, e.g. after a new context was made current or foreign code touched GL
+    void reset() {
+        mProgram = kUnknown;
+        mVertexArray = kUnknown;
+        std::fill(std::begin(mBuffers), std::end(mBuffers), kUnknown);
+        for (auto& unit : mTextures) {
+            std::fill(std::begin(unit), std::end(unit), kUnknown);
+        }
+        mActiveTexture = kUnknown;
+        mBlend = kUnknown;
+        mDepthTest = kUnknown;
+        mScissorTest = kUnknown;
+        mCullFace = kUnknown;
+        mDepthMask = kUnknown;
+        mBlendSrc = kUnknown;
+        mBlendDst = kUnknown;
+        mDepthFunc = kUnknown;
+        mClearColorKnown = false;
+        mViewportKnown = false;
+    }
+
+    void useProgram(GLuint program) {
+        if (update(mProgram, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    void bindVertexArray(GLuint vertexArray) {
+        if (update(mVertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+            // The element array binding is part of the vertex array object
+            mBuffers[ElementArrayBuffer] = kUnknown;
+        }
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer) {
+        int slot = bufferSlot(target);
+        if (slot < 0) {
+            glBindBuffer(target, buffer);
+            ++mCounters.issued;
+        } else if (update(mBuffers[slot], buffer)) {
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    // glBindBufferBase/Range also change the generic binding point
+    void onIndexedBufferBound(GLenum target, GLuint buffer) {
+        int slot = bufferSlot(target);
+        if (slot >= 0) {
+            mBuffers[slot] = buffer;
+        }
+    }
+
+    void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+        int slot = textureSlot(target);
+        if (unit >= kMaxTextureUnits || slot < 0) {
+            activeTexture(unit);
+            glBindTexture(target, texture);
+            ++mCounters.issued;
+            return;
+        }
+        if (update(mTextures[unit][slot], texture)) {
+            activeTexture(unit);
+            glBindTexture(target, texture);
+        }
+    }
+
+    // Binds even when the texture is cached as bound. Changes made to it on another
+    // context are only guaranteed to be seen here once it is bound again.
+    void rebindTexture(GLuint unit, GLenum target, GLuint texture) {
+        int slot = textureSlot(target);
+        if (unit < kMaxTextureUnits && slot >= 0) {
+            mTextures[unit][slot] = texture;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        ++mCounters.issued;
+    }
+
+    void activeTexture(GLuint unit) {
+        if (update(mActiveTexture, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    void setBlend(bool enabled) {
+        setCapability(mBlend, GL_BLEND, enabled);
+    }
+
+    void blendFunc(GLenum src, GLenum dst) {
+        if (mBlendSrc == src && mBlendDst == dst) {
+            ++mCounters.skipped;
+            return;
+        }
+        mBlendSrc = src;
+        mBlendDst = dst;
+        ++mCounters.issued;
+        glBlendFunc(src, dst);
+    }
+
+    void setDepthTest(bool enabled) {
+        setCapability(mDepthTest, GL_DEPTH_TEST, enabled);
+    }
+
+    void depthMask(bool enabled) {
+        if (update(mDepthMask, enabled ? GL_TRUE : GL_FALSE)) {
+            glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        }
+    }
+
+    void depthFunc(GLenum func) {
+        if (update(mDepthFunc, func)) {
+            glDepthFunc(func);
+        }
+    }
+
+    void setScissorTest(bool enabled) {
+        setCapability(mScissorTest, GL_SCISSOR_TEST, enabled);
+    }
+
+    void setCullFace(bool enabled) {
+        setCapability(mCullFace, GL_CULL_FACE, enabled);
+    }
+
+    void clearColor(float r, float g, float b, float a) {
+        if (mClearColorKnown && mClearColor[0] == r && mClearColor[1] == g && mClearColor[2] == b &&
+            mClearColor[3] == a) {
+            ++mCounters.skipped;
+            return;
+        }
+        mClearColor[0] = r;
+        mClearColor[1] = g;
+        mClearColor[2] = b;
+        mClearColor[3] = a;
+        mClearColorKnown = true;
+        ++mCounters.issued;
+        glClearColor(r, g, b, a);
+    }
+
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        if (mViewportKnown && mViewport[0] == x && mViewport[1] == y && mViewport[2] == width &&
+            mViewport[3] == height) {
+            ++mCounters.skipped;
+            return;
+        }
+        mViewport[0] = x;
+        mViewport[1] = y;
+        mViewport[2] = width;
+        mViewport[3] = height;
+        mViewportKnown = true;
+        ++mCounters.issued;
+        glViewport(x, y, width, height);
+    }
+
+    // Deleting a bound object silently unbinds it, and its name can be handed out again
+    void onProgramDeleted(GLuint program) {
+        if (mProgram == program) {
+            mProgram = kUnknown;
+        }
+    }
+
+    void onVertexArrayDeleted(GLuint vertexArray) {
+        if (mVertexArray == vertexArray) {
+            mVertexArray = kUnknown;
+        }
+    }
+
+    void onBufferDeleted(GLuint buffer) {
+        for (GLuint& bound : mBuffers) {
+            if (bound == buffer) {
+                bound = kUnknown;
+            }
+        }
+    }
+
+    void onTextureDeleted(GLuint texture) {
+        for (auto& unit : mTextures) {
+            for (GLuint& bound : unit) {
+                if (bound == texture) {
+                    bound = kUnknown;
+                }
+            }
+        }
+    }
+
+    // Returns the counts since the previous call
+    Counters takeCounters() {
+        Counters counters = mCounters;
+        mCounters = {};
+        return counters;
+    }
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <GLES3/gl31.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "GLStateCache.h"
+#include "Log.h"
+#include "ShaderProgram.h"
+#include "TriangleMesh.h"
+#include "UniformRing.h"
+#include "Uniforms.h"
+
+// GPU-driven culling and drawing for large static scenes.
+// Every object lives in a shader storage buffer. Each frame a compute pass tests the
+// bounding spheres against the frustum, appends the visible instances to the mesh's
+// range of a compacted instance buffer and counts them into that mesh's indirect
+// command, so the CPU issues one indirect draw per mesh and never reads anything back.
+// GLES indirect commands have no base instance, so each mesh's instances start at a
+// fixed offset sized for all of its objects and are bound per draw instead.
+class GpuCuller {
+public:
+    // One object as the compute shader reads it, std430
+    struct Object {
+        float sphere[4];  // Centre and radius
+        InstanceData instance;
+        uint32_t mesh;           // Index into the meshes passed to initialize()
+        uint32_t firstInstance;  // Filled in by initialize()
+        uint32_t padding[2];
+    };
+
+private:
+    static constexpr GLuint kWorkGroupSize = 64;
+    // Shader storage binding points
+    static constexpr GLuint kObjectBinding = 0;
+    static constexpr GLuint kInstanceBinding = 1;
+    static constexpr GLuint kCommandBinding = 2;
+
+    // Also laid out as DrawArraysIndirectCommand, whose fields are a prefix of this one
+    struct Command {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLint baseVertex;
+        GLuint reserved;
+    };
+
+    static constexpr char kCullShaderSource[] = R"(#version 320 es
+    layout(local_size_x = 64) in;
+    struct Object {
+        vec4 sphere;
+        mat4 transform;
+        vec4 color;
+        uint mesh;
+        uint firstInstance;
+    };
+    struct Instance {
+        mat4 transform;
+        vec4 color;
+    };
+    struct Command {
+        uint count;
+        uint instanceCount;
+        uint first;
+        int baseVertex;
+        uint reserved;
+    };
+    layout(std430, binding = 0) readonly buffer Objects {
+        Object objects[];
+    };
+    layout(std430, binding = 1) writeonly buffer Instances {
+        Instance instances[];
+    };
+    layout(std430, binding = 2) buffer Commands {
+        Command commands[];
+    };
+    uniform vec4 uPlanes[6];
+    uniform uint uObjectCount;
+    void main() {
+        uint index = gl_GlobalInvocationID.x;
+        if (index >= uObjectCount) {
+            return;
+        }
+        Object object = objects[index];
+        for (int i = 0; i < 6; ++i) {
+            if (dot(uPlanes[i].xyz, object.sphere.xyz) + uPlanes[i].w <= -object.sphere.w) {
+                return;
+            }
+        }
+        uint slot = atomicAdd(commands[object.mesh].instanceCount, 1u);
+        instances[object.firstInstance + slot] = Instance(object.transform, object.color);
+    })";
+
+    static_assert(sizeof(Object) == 112, "Object must match the std430 struct");
+    static_assert(sizeof(Command) == 20, "Command must match the std430 struct");
+
+    std::vector<TriangleMesh*> mMeshes;
+    std::vector<GLuint> mFirstInstances;
+    // Per mesh; the commands are rewritten as meshes finish loading
+    std::vector<GLsizei> mCommandCounts;
+    FrustumCuller mFrustum;
+    FrameUniforms mFrameUniforms = kDefaultFrameUniforms;
+    UniformRing mUniforms;
+    GLuint mProgram = 0;
+    GLint mPlanesLocation = -1;
+    GLint mObjectCountLocation = -1;
+    GLuint mObjectBuffer = 0;
+    GLuint mInstanceBuffer = 0;
+    GLuint mCommandBuffer = 0;
+    // Commands with every instance count at zero, copied over mCommandBuffer before each cull
+    GLuint mCommandTemplate = 0;
+    uint32_t mObjectCount = 0;
+
+    bool createProgram() {
+        GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+        const char* source = kCullShaderSource;
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+            LOG_ERROR("Cull shader compilation error: %s", infoLog);
+            glDeleteShader(shader);
+            return false;
+        }
+
+        mProgram = glCreateProgram();
+        glAttachShader(mProgram, shader);
+        glLinkProgram(mProgram);
+        glDeleteShader(shader);
+        glGetProgramiv(mProgram, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(mProgram, 512, nullptr, infoLog);
+            LOG_ERROR("Cull program link error: %s", infoLog);
+            glDeleteProgram(mProgram);
+            mProgram = 0;
+            return false;
+        }
+        mPlanesLocation = glGetUniformLocation(mProgram, "uPlanes");
+        mObjectCountLocation = glGetUniformLocation(mProgram, "uObjectCount");
+        return true;
+    }
+
+    GLuint createBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        GLStateCache::current().bindBuffer(target, buffer);
+        glBufferData(target, size, data, usage);
+        return buffer;
+    }
+
+    // A mesh's vertex count is only known once its upload has finished
+    void updateCommands() {
+        GLStateCache& state = GLStateCache::current();
+        for (size_t i = 0; i < mMeshes.size(); ++i) {
+            GLsizei count = mMeshes[i]->isReady() ? mMeshes[i]->drawCount() : 0;
+            if (count == mCommandCounts[i]) {
+                continue;
+            }
+            mCommandCounts[i] = count;
+            Command command = {static_cast<GLuint>(count), 0, 0, 0, 0};
+            state.bindBuffer(GL_COPY_WRITE_BUFFER, mCommandTemplate);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(i * sizeof(Command)), sizeof(Command),
+                            &command);
+        }
+    }
+
+    static void deleteBuffer(GLuint& buffer) {
+        if (buffer) {
+            GLStateCache::current().onBufferDeleted(buffer);
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+        }
+    }
+
+public:
+    GpuCuller() = default;
+    ~GpuCuller() {
+        cleanup();
+    }
+
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // Must be called with a current context. The meshes need enableInstancing() for the
+    // attribute layout, may still be loading and must outlive the culler.
+    bool initialize(const std::vector<TriangleMesh*>& meshes, std::vector<Object> objects) {
+        cleanup();
+        mMeshes = meshes;
+        mFirstInstances.assign(meshes.size(), 0);
+        mCommandCounts.assign(meshes.size(), -1);
+        mObjectCount = static_cast<uint32_t>(objects.size());
+
+        // Each mesh gets room for all of its objects, in mesh order
+        std::vector<GLuint> meshObjects(meshes.size(), 0);
+        for (const Object& object : objects) {
+            ++meshObjects[object.mesh];
+        }
+        GLuint first = 0;
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            mFirstInstances[i] = first;
+            first += meshObjects[i];
+        }
+        for (Object& object : objects) {
+            object.firstInstance = mFirstInstances[object.mesh];
+        }
+
+        if (!createProgram() || !mUniforms.initialize(2, sizeof(FrameUniforms))) {
+            return false;
+        }
+        mObjectBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER,
+                                     static_cast<GLsizeiptr>(objects.size() * sizeof(Object)), objects.data(),
+                                     GL_STATIC_DRAW);
+        mInstanceBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER,
+                                       static_cast<GLsizeiptr>(objects.size() * sizeof(InstanceData)), nullptr,
+                                       GL_DYNAMIC_COPY);
+        std::vector<Command> commands(meshes.size(), Command{0, 0, 0, 0, 0});
+        auto commandSize = static_cast<GLsizeiptr>(commands.size() * sizeof(Command));
+        mCommandBuffer = createBuffer(GL_DRAW_INDIRECT_BUFFER, commandSize, nullptr, GL_DYNAMIC_COPY);
+        mCommandTemplate = createBuffer(GL_COPY_WRITE_BUFFER, commandSize, commands.data(), GL_DYNAMIC_DRAW);
+        LOG_INFO("GPU culling of %u objects over %zu meshes", mObjectCount, meshes.size());
+        return mObjectBuffer && mInstanceBuffer && mCommandBuffer && mCommandTemplate;
+    }
+
+    // Column major; culls against and draws with it from the next frame on
+    void setViewProjection(const float matrix[16]) {
+        std::copy(matrix, matrix + 16, mFrameUniforms.viewProjection);
+        mFrustum.setViewProjection(matrix);
+    }
+
+    // Records the compute pass. Call outside of any render pass, since on tiled GPUs a
+    // dispatch in the middle of one flushes its tiles.
+    void cull() {
+        if (!mProgram || mObjectCount == 0) {
+            return;
+        }
+        updateCommands();
+
+        GLStateCache& state = GLStateCache::current();
+        state.bindBuffer(GL_COPY_READ_BUFFER, mCommandTemplate);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, mCommandBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                            static_cast<GLsizeiptr>(mMeshes.size() * sizeof(Command)));
+
+        state.useProgram(mProgram);
+        glUniform4fv(mPlanesLocation, 6, mFrustum.planes());
+        glUniform1ui(mObjectCountLocation, mObjectCount);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kObjectBinding, mObjectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, mInstanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandBinding, mCommandBuffer);
+        state.onIndexedBufferBound(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+        glDispatchCompute((mObjectCount + kWorkGroupSize - 1) / kWorkGroupSize, 1, 1);
+        // The draws read what the pass wrote as commands and as instance attributes, and the
+        // next cull() overwrites the counts with glCopyBufferSubData
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    // One indirect draw per loaded mesh with what the last cull() kept; returns the draw count.
+    // The program needs the instanced layout and gets setViewProjection() and a white tint.
+    uint32_t draw(ShaderProgram& program) {
+        if (!mProgram || mObjectCount == 0 || !program.isReady()) {
+            return 0;
+        }
+
+        mUniforms.beginFrame();
+        StreamBuffer::Allocation frameUniforms = mUniforms.allocate(sizeof(FrameUniforms));
+        StreamBuffer::Allocation batchUniforms = {nullptr, 0, 0};
+        if (frameUniforms.data) {
+            *mUniforms.element<FrameUniforms>(frameUniforms, 0) = mFrameUniforms;
+            mUniforms.commit(frameUniforms);
+            batchUniforms = mUniforms.allocate(sizeof(BatchUniforms));
+        }
+        uint32_t draws = 0;
+        if (batchUniforms.data) {
+            *mUniforms.element<BatchUniforms>(batchUniforms, 0) = kDefaultBatchUniforms;
+            mUniforms.commit(batchUniforms);
+            mUniforms.bind(UniformBlock::Frame, frameUniforms, 0, sizeof(FrameUniforms));
+            mUniforms.bind(UniformBlock::Batch, batchUniforms, 0, sizeof(BatchUniforms));
+
+            program.use();
+            GLStateCache::current().bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+            for (size_t i = 0; i < mMeshes.size(); ++i) {
+                if (mCommandCounts[i] <= 0) {
+                    continue;
+                }
+                mMeshes[i]->bindInstanceSource(mInstanceBuffer,
+                                               static_cast<GLintptr>(mFirstInstances[i] * sizeof(InstanceData)));
+                mMeshes[i]->drawIndirect(static_cast<GLintptr>(i * sizeof(Command)));
+                ++draws;
+            }
+        }
+        mUniforms.endFrame();
+        return draws;
+    }
+
+    void cleanup() {
+        if (mProgram) {
+            GLStateCache::current().onProgramDeleted(mProgram);
+            glDeleteProgram(mProgram);
+            mProgram = 0;
+        }
+        deleteBuffer(mObjectBuffer);
+        deleteBuffer(mInstanceBuffer);
+        deleteBuffer(mCommandBuffer);
+        deleteBuffer(mCommandTemplate);
+        mUniforms.cleanup();
+    }
+
+    // Forget the GL objects without deleting them, for when their context is already gone
+    void invalidate() {
+        mProgram = 0;
+        mObjectBuffer = 0;
+        mInstanceBuffer = 0;
+        mCommandBuffer = 0;
+        mCommandTemplate = 0;
+        mUniforms.invalidate();
+    }
+};
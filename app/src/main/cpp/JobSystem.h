@@ -0,0 +1,379 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Log.h"
+
+// Tracks a group of jobs; wait() on it returns once all of them have run
+class JobCounter {
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> mPending{0};
+
+public:
+    [[nodiscard]]
+    bool isDone() const {
+        return mPending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+// Fixed pool of worker threads with one work-stealing deque per thread.
+// A thread pushes and pops its own deque from the bottom while idle threads steal from
+// the top, so there is no shared queue to contend on. Threads other than the workers
+// (the render thread, android_main) get a deque through registerThread() and may then
+// submit jobs and help run them inside wait(). Jobs must not block on anything but wait().
+class JobSystem {
+public:
+    using JobFunction = void (*)(void* data, uint32_t begin, uint32_t end);
+
+private:
+    static constexpr size_t kMaxThreads = 16;
+    static constexpr size_t kQueueCapacity = 1024;
+    static constexpr size_t kQueueMask = kQueueCapacity - 1;
+    static constexpr int kSpinsBeforeSleep = 64;
+
+    struct Job {
+        JobFunction function;
+        void* data;
+        uint32_t begin;
+        uint32_t end;
+        JobCounter* counter;
+    };
+
+    // Chase-Lev deque of pointers into per-thread job storage.
+    // A storage slot is reused after kQueueCapacity further submissions from the same
+    // thread, which the full-deque check keeps from overtaking jobs still queued.
+    struct alignas(64) WorkQueue {
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Job*> jobs[kQueueCapacity] = {};
+        Job storage[kQueueCapacity] = {};
+        uint32_t nextStorage = 0;
+
+        // Owner only
+        bool push(const Job& job) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= static_cast<int64_t>(kQueueCapacity)) {
+                return false;
+            }
+            Job* slot = &storage[nextStorage++ & kQueueMask];
+            *slot = job;
+            jobs[b & kQueueMask].store(slot, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Owner only
+        bool pop(Job& job) {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            Job* slot = jobs[b & kQueueMask].load(std::memory_order_relaxed);
+            if (t == b) {
+                // Last job, race the thieves for it
+                bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                if (!won) {
+                    return false;
+                }
+            }
+            job = *slot;
+            return true;
+        }
+
+        // Any thread
+        bool steal(Job& job) {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return false;
+            }
+
+            Job* slot = jobs[t & kQueueMask].load(std::memory_order_relaxed);
+            Job copy = *slot;
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return false;
+            }
+            job = copy;
+            return true;
+        }
+    };
+
+    struct ThreadSlot {
+        JobSystem* system = nullptr;
+        size_t index = 0;
+    };
+
+    static ThreadSlot& threadSlot() {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    // Heap allocated, the deques are far too big for the android_main stack
+    std::unique_ptr<WorkQueue[]> mQueues = std::make_unique<WorkQueue[]>(kMaxThreads);
+    std::atomic<size_t> mThreadCount{0};
+    std::vector<std::thread> mWorkers;
+    std::vector<int32_t> mWorkerThreadIds;
+    std::atomic<size_t> mWorkersStarted{0};
+    std::atomic<bool> mStop{false};
+
+    // Workers with nothing to steal sleep until the next submission
+    std::mutex mSleepMutex;
+    std::condition_variable mSleepCondition;
+    std::atomic<uint64_t> mSubmissions{0};
+    std::atomic<uint32_t> mSleepers{0};
+
+    // Highest cpuinfo_max_freq of each core, or 0 when cpufreq isn't readable
+    static std::vector<uint32_t> coreFrequencies() {
+        long configured = sysconf(_SC_NPROCESSORS_CONF);
+        std::vector<uint32_t> frequencies(configured > 0 ? static_cast<size_t>(configured) : 1, 0);
+        for (size_t cpu = 0; cpu < frequencies.size(); ++cpu) {
+            char path[96];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%zu/cpufreq/cpuinfo_max_freq", cpu);
+            if (FILE* file = fopen(path, "r")) {
+                unsigned frequency = 0;
+                if (fscanf(file, "%u", &frequency) == 1) {
+                    frequencies[cpu] = frequency;
+                }
+                fclose(file);
+            }
+        }
+        return frequencies;
+    }
+
+    // Pins the calling thread to every core of the given core type, not one particular core
+    static void pinToCoreType(const std::vector<uint32_t>& frequencies, uint32_t frequency) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t cpu = 0; cpu < frequencies.size() && cpu < CPU_SETSIZE; ++cpu) {
+            if (frequencies[cpu] == frequency) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            LOG_ERROR("Failed to pin worker to %u kHz cores", frequency);
+        }
+    }
+
+    size_t claimThreadSlot() {
+        size_t index = mThreadCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= kMaxThreads) {
+            mThreadCount.fetch_sub(1, std::memory_order_relaxed);
+            return kMaxThreads;
+        }
+        threadSlot() = {this, index};
+        return index;
+    }
+
+    void execute(const Job& job) {
+        job.function(job.data, job.begin, job.end);
+        job.counter->mPending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    bool findJob(size_t self, Job& job) {
+        if (self < kMaxThreads && mQueues[self].pop(job)) {
+            return true;
+        }
+        size_t count = mThreadCount.load(std::memory_order_acquire);
+        for (size_t i = 1; i <= count; ++i) {
+            size_t victim = (self + i) % count;
+            if (victim != self && mQueues[victim].steal(job)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t index, const std::vector<uint32_t>& frequencies, uint32_t frequency) {
+        threadSlot() = {this, index};
+        char name[16];
+        snprintf(name, sizeof(name), "Worker%zu", index);
+        pthread_setname_np(pthread_self(), name);
+        if (frequency) {
+            pinToCoreType(frequencies, frequency);
+        }
+
+        int idleSpins = 0;
+        while (!mStop.load(std::memory_order_acquire)) {
+            uint64_t seen = mSubmissions.load(std::memory_order_acquire);
+            Job job;
+            if (findJob(index, job)) {
+                execute(job);
+                idleSpins = 0;
+                continue;
+            }
+            if (++idleSpins < kSpinsBeforeSleep) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleepers.fetch_add(1, std::memory_order_seq_cst);
+            mSleepCondition.wait(lock, [&] {
+                return mStop.load(std::memory_order_acquire) ||
+                       mSubmissions.load(std::memory_order_acquire) != seen;
+            });
+            mSleepers.fetch_sub(1, std::memory_order_relaxed);
+            idleSpins = 0;
+        }
+    }
+
+    void wakeWorkers(uint32_t jobs) {
+        mSubmissions.fetch_add(1, std::memory_order_seq_cst);
+        if (mSleepers.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        // Taking the lock orders this against a worker that is about to sleep
+        { std::lock_guard<std::mutex> lock(mSleepMutex); }
+        if (jobs == 1) {
+            mSleepCondition.notify_one();
+        } else {
+            mSleepCondition.notify_all();
+        }
+    }
+
+    void submit(const Job& job) {
+        ThreadSlot& slot = threadSlot();
+        if (slot.system != this || !mQueues[slot.index].push(job)) {
+            // Unregistered thread or full deque: run it right here instead
+            execute(job);
+        }
+    }
+
+public:
+    JobSystem() = default;
+    ~JobSystem() {
+        stop();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // One worker per core except the fastest, which is left to the render thread.
+    // Each worker may float across the cores of its type but not to another type.
+    void start() {
+        std::vector<uint32_t> frequencies = coreFrequencies();
+        std::vector<size_t> cores(frequencies.size());
+        for (size_t i = 0; i < cores.size(); ++i) {
+            cores[i] = i;
+        }
+        std::stable_sort(cores.begin(), cores.end(),
+                         [&](size_t a, size_t b) { return frequencies[a] > frequencies[b]; });
+
+        size_t workerCount = std::min(std::max<size_t>(cores.size(), 2) - 1, kMaxThreads / 2);
+        mWorkerThreadIds.assign(workerCount, 0);
+        for (size_t i = 0; i < workerCount; ++i) {
+            uint32_t frequency = frequencies[cores[(i + 1) % cores.size()]];
+            size_t index = mThreadCount.fetch_add(1, std::memory_order_relaxed);
+            mWorkers.emplace_back([this, i, index, frequencies, frequency] {
+                mWorkerThreadIds[i] = gettid();
+                mWorkersStarted.fetch_add(1, std::memory_order_release);
+                workerLoop(index, frequencies, frequency);
+            });
+        }
+        // Thread ids are only known once each worker runs, and callers may ask for them next
+        while (mWorkersStarted.load(std::memory_order_acquire) < workerCount) {
+            std::this_thread::yield();
+        }
+        LOG_INFO("Job system started %zu workers on %zu cores", workerCount, cores.size());
+    }
+
+    void stop() {
+        if (mWorkers.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mStop.store(true, std::memory_order_release);
+        }
+        mSleepCondition.notify_all();
+        for (std::thread& worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+        mWorkerThreadIds.clear();
+    }
+
+    // Gives the calling thread its own deque; call once on every non-worker thread that submits
+    bool registerThread() {
+        if (threadSlot().system == this) {
+            return true;
+        }
+        if (claimThreadSlot() == kMaxThreads) {
+            LOG_ERROR("Job system out of thread slots, jobs from this thread run inline");
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]]
+    size_t workerCount() const {
+        return mWorkers.size();
+    }
+
+    // Kernel thread ids of the workers, valid once start() has returned
+    [[nodiscard]]
+    const std::vector<int32_t>& workerThreadIds() const {
+        return mWorkerThreadIds;
+    }
+
+    void run(JobFunction function, void* data, JobCounter& counter) {
+        counter.mPending.fetch_add(1, std::memory_order_relaxed);
+        submit({function, data, 0, 1, &counter});
+        wakeWorkers(1);
+    }
+
+    // Splits [0, count) into jobs of at most grain items; body(begin, end) must outlive wait()
+    template <typename Body>
+    void parallelFor(uint32_t count, uint32_t grain, JobCounter& counter, Body& body) {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max<uint32_t>(grain, 1);
+        JobFunction trampoline = [](void* data, uint32_t begin, uint32_t end) {
+            (*static_cast<Body*>(data))(begin, end);
+        };
+
+        uint32_t jobs = (count + grain - 1) / grain;
+        counter.mPending.fetch_add(jobs, std::memory_order_relaxed);
+        for (uint32_t begin = 0; begin < count; begin += grain) {
+            submit({trampoline, &body, begin, std::min(begin + grain, count), &counter});
+        }
+        wakeWorkers(jobs);
+    }
+
+    // Runs queued jobs on the calling thread until the counter drains
+    void wait(const JobCounter& counter) {
+        ThreadSlot& slot = threadSlot();
+        size_t self = slot.system == this ? slot.index : kMaxThreads;
+        while (!counter.isDone()) {
+            Job job;
+            if (findJob(self, job)) {
+                execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <android/asset_manager.h>
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <cstring>
+
+#include "Log.h"
+
+// A KTX2 container read in place from an asset, like MeshAsset.
+// Only 2D textures without supercompression in ETC2 or ASTC LDR formats are accepted,
+// since those upload as-is with glCompressedTexSubImage2D.
+class Ktx2File {
+public:
+    struct Level {
+        const void* data;
+        GLsizei size;
+        GLsizei width;
+        GLsizei height;
+    };
+
+private:
+    static constexpr uint8_t kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    static constexpr size_t kMaxLevels = 16;
+
+    // Everything up to the level index
+    struct Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Header) == 80, "Header layout is part of the file format");
+
+    struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    AAsset* mAsset = nullptr;
+    const uint8_t* mData = nullptr;
+    Header mHeader = {};
+    GLenum mFormat = 0;
+    Level mLevels[kMaxLevels] = {};
+
+    // VkFormat to the GLES compressed format with the same bits
+    static GLenum glFormat(uint32_t vkFormat) {
+        switch (vkFormat) {
+            case 147: return GL_COMPRESSED_RGB8_ETC2;
+            case 148: return GL_COMPRESSED_SRGB8_ETC2;
+            case 149: return GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+            case 150: return GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+            case 151: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+            case 152: return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+            default: break;
+        }
+        // VK_FORMAT_ASTC_4x4_UNORM_BLOCK to ASTC_12x12_SRGB alternate UNORM and SRGB in
+        // the same block-size order as GL_COMPRESSED_RGBA_ASTC_* and SRGB8_ALPHA8_ASTC_*
+        if (vkFormat >= 157 && vkFormat <= 184) {
+            uint32_t blockSize = (vkFormat - 157) / 2;
+            bool srgb = (vkFormat - 157) % 2 == 1;
+            return (srgb ? 0x93D0 : 0x93B0) + blockSize;
+        }
+        return 0;
+    }
+
+    bool parse(size_t length) {
+        const size_t indexStart = sizeof(Header);
+        if (length < indexStart) {
+            return false;
+        }
+        memcpy(&mHeader, mData, sizeof(mHeader));
+        if (memcmp(mHeader.identifier, kIdentifier, sizeof(kIdentifier)) != 0) {
+            return false;
+        }
+        mFormat = glFormat(mHeader.vkFormat);
+        uint32_t levelCount = mHeader.levelCount ? mHeader.levelCount : 1;
+        if (mFormat == 0 || mHeader.supercompressionScheme != 0 || mHeader.pixelDepth > 1 ||
+            mHeader.layerCount > 1 || mHeader.faceCount != 1 || levelCount > kMaxLevels ||
+            length < indexStart + levelCount * sizeof(LevelIndex)) {
+            return false;
+        }
+
+        mHeader.levelCount = levelCount;
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            LevelIndex index;
+            memcpy(&index, mData + indexStart + level * sizeof(LevelIndex), sizeof(index));
+            if (index.byteOffset + index.byteLength > length) {
+                return false;
+            }
+            GLsizei width = static_cast<GLsizei>(mHeader.pixelWidth >> level);
+            GLsizei height = static_cast<GLsizei>(mHeader.pixelHeight >> level);
+            mLevels[level] = {mData + index.byteOffset, static_cast<GLsizei>(index.byteLength),
+                              width > 0 ? width : 1, height > 0 ? height : 1};
+        }
+        return true;
+    }
+
+public:
+    Ktx2File() = default;
+    ~Ktx2File() {
+        close();
+    }
+
+    Ktx2File(const Ktx2File&) = delete;
+    Ktx2File& operator=(const Ktx2File&) = delete;
+
+    bool open(AAssetManager* assetManager, const char* path) {
+        close();
+        mAsset = AAssetManager_open(assetManager, path, AASSET_MODE_BUFFER);
+        if (!mAsset) {
+            return false;
+        }
+
+        mData = static_cast<const uint8_t*>(AAsset_getBuffer(mAsset));
+        if (!mData || !parse(static_cast<size_t>(AAsset_getLength64(mAsset)))) {
+            LOG_ERROR("Texture asset %s is not an uncompressed 2D ETC2/ASTC KTX2 file", path);
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (mAsset) {
+            AAsset_close(mAsset);
+            mAsset = nullptr;
+            mData = nullptr;
+        }
+    }
+
+    [[nodiscard]]
+    bool isOpen() const {
+        return mAsset != nullptr;
+    }
+
+    [[nodiscard]]
+    GLenum format() const {
+        return mFormat;
+    }
+
+    [[nodiscard]]
+    GLsizei width() const {
+        return static_cast<GLsizei>(mHeader.pixelWidth);
+    }
+
+    [[nodiscard]]
+    GLsizei height() const {
+        return static_cast<GLsizei>(mHeader.pixelHeight);
+    }
+
+    // Level 0 is the full-size image
+    [[nodiscard]]
+    GLsizei levelCount() const {
+        return static_cast<GLsizei>(mHeader.levelCount);
+    }
+
+    [[nodiscard]]
+    const Level& level(GLsizei index) const {
+        return mLevels[index];
+    }
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <android/log.h>
+
+#define LOG_TAG "RealNativeApp"
+#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <android/asset_manager.h>
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <cstring>
+
+#include "Log.h"
+#include "TriangleMesh.h"
+#include "VertexLayout.h"
+
+// Binary mesh container, little-endian, written by tools/mesh_pack.py:
+//   MeshFileHeader, then the vertex blob at vertexOffset and the index blob at indexOffset,
+//   both already in the GPU layout the header describes and 4-byte aligned.
+struct MeshFileHeader {
+    static constexpr uint32_t kMagic = 0x48534D4E;  // "NMSH"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kMaxAttributes = 8;
+
+    struct Attribute {
+        uint32_t location;
+        uint32_t format;  // VertexFormat
+    };
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;  // 2 or 4 bytes, 0 without indices
+    uint32_t attributeCount;
+    Attribute attributes[kMaxAttributes];
+    uint32_t vertexOffset;
+    uint32_t indexOffset;
+    float boundsCenter[3];
+    float boundsRadius;
+};
+static_assert(sizeof(MeshFileHeader) == 112, "MeshFileHeader layout is part of the file format");
+
+// A mesh asset opened with AASSET_MODE_BUFFER so the blobs are read in place.
+// Assets stored uncompressed in the APK (see noCompress in build.gradle) are mmapped and
+// upload() hands GL a pointer straight into the mapping, with no copy on our side.
+// Keeping the asset open lets the mesh be uploaded again after a context loss.
+class MeshAsset {
+private:
+    AAsset* mAsset = nullptr;
+    const uint8_t* mData = nullptr;
+    MeshFileHeader mHeader = {};
+    VertexLayout mLayout;
+
+    bool validate(size_t length) {
+        if (length < sizeof(MeshFileHeader)) {
+            return false;
+        }
+        memcpy(&mHeader, mData, sizeof(mHeader));
+        if (mHeader.magic != MeshFileHeader::kMagic || mHeader.version != MeshFileHeader::kVersion ||
+            mHeader.attributeCount == 0 || mHeader.attributeCount > MeshFileHeader::kMaxAttributes ||
+            (mHeader.indexSize != 0 && mHeader.indexSize != 2 && mHeader.indexSize != 4)) {
+            return false;
+        }
+
+        mLayout = VertexLayout();
+        for (uint32_t i = 0; i < mHeader.attributeCount; ++i) {
+            if (mHeader.attributes[i].format > static_cast<uint32_t>(VertexFormat::UShort2Norm)) {
+                return false;
+            }
+            mLayout.add(mHeader.attributes[i].location, static_cast<VertexFormat>(mHeader.attributes[i].format));
+        }
+
+        uint64_t vertexEnd = mHeader.vertexOffset + static_cast<uint64_t>(mHeader.vertexCount) * mLayout.stride();
+        uint64_t indexEnd = mHeader.indexOffset + static_cast<uint64_t>(mHeader.indexCount) * mHeader.indexSize;
+        return vertexEnd <= length && indexEnd <= length && mHeader.vertexOffset % 4 == 0 &&
+               mHeader.indexOffset % 4 == 0;
+    }
+
+public:
+    MeshAsset() = default;
+    ~MeshAsset() {
+        close();
+    }
+
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+
+    bool open(AAssetManager* assetManager, const char* path) {
+        close();
+        mAsset = AAssetManager_open(assetManager, path, AASSET_MODE_BUFFER);
+        if (!mAsset) {
+            return false;
+        }
+
+        mData = static_cast<const uint8_t*>(AAsset_getBuffer(mAsset));
+        auto length = static_cast<size_t>(AAsset_getLength64(mAsset));
+        if (!mData || !validate(length)) {
+            LOG_ERROR("Mesh asset %s is not a valid mesh file", path);
+            close();
+            return false;
+        }
+        if (AAsset_isAllocated(mAsset)) {
+            LOG_INFO("Mesh asset %s is compressed in the APK, so it was inflated instead of mapped", path);
+        }
+        LOG_INFO("Loaded mesh %s: %u vertices, %u indices", path, mHeader.vertexCount, mHeader.indexCount);
+        return true;
+    }
+
+    void close() {
+        if (mAsset) {
+            AAsset_close(mAsset);
+            mAsset = nullptr;
+            mData = nullptr;
+        }
+    }
+
+    [[nodiscard]]
+    bool isOpen() const {
+        return mAsset != nullptr;
+    }
+
+    [[nodiscard]]
+    const MeshFileHeader& header() const {
+        return mHeader;
+    }
+
+    // Whether the vertices carry an attribute for this shader location
+    [[nodiscard]]
+    bool hasAttribute(GLuint location) const {
+        for (uint32_t i = 0; i < mHeader.attributeCount; ++i) {
+            if (mHeader.attributes[i].location == location) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Creates the mesh's buffers; may run on the asset loader's shared context, after which
+    // the mesh still needs createVertexArray() on the context that draws it
+    bool upload(TriangleMesh& mesh) const {
+        if (!mAsset) {
+            return false;
+        }
+        const uint8_t* indices = mHeader.indexCount > 0 ? mData + mHeader.indexOffset : nullptr;
+        return mesh.uploadBuffers(mData + mHeader.vertexOffset, static_cast<GLsizei>(mHeader.vertexCount), mLayout,
+                                  indices, static_cast<GLsizei>(mHeader.indexCount),
+                                  mHeader.indexSize == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT);
+    }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <dlfcn.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Log.h"
+
+// Android Dynamic Performance Framework hint session.
+// Tells the CPU governor how long each frame's work took against the frame budget, so it
+// clocks the render and worker threads for the load instead of guessing from utilisation.
+// APerformanceHint needs API 33 and is resolved at runtime; without it every call is a no-op.
+class PerformanceHint {
+private:
+    using GetManagerFn = void* (*)();
+    using CreateSessionFn = void* (*)(void*, const int32_t*, size_t, int64_t);
+    using UpdateTargetFn = int (*)(void*, int64_t);
+    using ReportActualFn = int (*)(void*, int64_t);
+    using CloseSessionFn = void (*)(void*);
+
+    UpdateTargetFn mUpdateTarget = nullptr;
+    ReportActualFn mReportActual = nullptr;
+    CloseSessionFn mCloseSession = nullptr;
+    void* mSession = nullptr;
+    int64_t mTargetNs = 0;
+
+public:
+    PerformanceHint() = default;
+    ~PerformanceHint() {
+        cleanup();
+    }
+
+    PerformanceHint(const PerformanceHint&) = delete;
+    PerformanceHint& operator=(const PerformanceHint&) = delete;
+
+    // Every thread that works on frames belongs in the session
+    bool initialize(const std::vector<int32_t>& threadIds, int64_t targetNs) {
+        void* lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (!lib) {
+            return false;
+        }
+        auto getManager = reinterpret_cast<GetManagerFn>(dlsym(lib, "APerformanceHint_getManager"));
+        auto createSession = reinterpret_cast<CreateSessionFn>(dlsym(lib, "APerformanceHint_createSession"));
+        mUpdateTarget = reinterpret_cast<UpdateTargetFn>(dlsym(lib, "APerformanceHint_updateTargetWorkDuration"));
+        mReportActual = reinterpret_cast<ReportActualFn>(dlsym(lib, "APerformanceHint_reportActualWorkDuration"));
+        mCloseSession = reinterpret_cast<CloseSessionFn>(dlsym(lib, "APerformanceHint_closeSession"));
+
+        void* manager = getManager && createSession && mUpdateTarget && mReportActual && mCloseSession
+                ? getManager() : nullptr;
+        // The manager is null where the device doesn't support hint sessions
+        mSession = manager ? createSession(manager, threadIds.data(), threadIds.size(), targetNs) : nullptr;
+        if (!mSession) {
+            LOG_INFO("Performance hint sessions not available");
+            return false;
+        }
+        mTargetNs = targetNs;
+        LOG_INFO("Performance hint session for %zu threads", threadIds.size());
+        return true;
+    }
+
+    // Once per frame with the CPU time the frame took, not counting waits for the display
+    void reportWork(int64_t actualNs, int64_t targetNs) {
+        if (!mSession || actualNs <= 0) {
+            return;
+        }
+        if (targetNs != mTargetNs && targetNs > 0) {
+            mUpdateTarget(mSession, targetNs);
+            mTargetNs = targetNs;
+        }
+        mReportActual(mSession, actualNs);
+    }
+
+    void cleanup() {
+        if (mSession) {
+            mCloseSession(mSession);
+            mSession = nullptr;
+        }
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Fixed-capacity pool of T for long-lived objects such as GPU resource wrappers.
+// All storage is allocated up front and freed slots are kept on an intrusive free list,
+// so create() and destroy() never touch the heap. Single-threaded, like the GL objects
+// it is meant to hold.
+template <typename T>
+class PoolAllocator {
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    Slot* mFreeList = nullptr;
+    size_t mCapacity = 0;
+    size_t mLive = 0;
+    size_t mHighWater = 0;
+
+public:
+    explicit PoolAllocator(size_t capacity)
+        : mSlots(std::make_unique<Slot[]>(capacity)), mCapacity(capacity) {
+        for (size_t i = 0; i < capacity; ++i) {
+            mSlots[i].next = i + 1 < capacity ? &mSlots[i + 1] : nullptr;
+        }
+        mFreeList = capacity > 0 ? &mSlots[0] : nullptr;
+    }
+
+    // Every object must have been destroyed by now
+    ~PoolAllocator() = default;
+
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    // Returns nullptr when the pool is full
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (!mFreeList) {
+            return nullptr;
+        }
+        Slot* slot = mFreeList;
+        mFreeList = slot->next;
+        if (++mLive > mHighWater) {
+            mHighWater = mLive;
+        }
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object) {
+        if (!object) {
+            return;
+        }
+        object->~T();
+        auto* slot = reinterpret_cast<Slot*>(object);
+        slot->next = mFreeList;
+        mFreeList = slot;
+        --mLive;
+    }
+
+    [[nodiscard]]
+    size_t live() const {
+        return mLive;
+    }
+
+    [[nodiscard]]
+    size_t highWater() const {
+        return mHighWater;
+    }
+
+    [[nodiscard]]
+    size_t capacity() const {
+        return mCapacity;
+    }
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <sys/stat.h>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Log.h"
+
+// On-disk cache of linked program binaries.
+// Entries are keyed by a hash of the shader sources plus GL_RENDERER and GL_VERSION,
+// so a driver update or a shader edit simply misses instead of loading a stale blob.
+class ProgramCache {
+private:
+    static constexpr uint32_t kMagic = 0x50524743;  // "PRGC"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t key;
+    };
+
+    std::string mDirectory;
+    uint64_t mDriverHash = 0;
+    bool mEnabled = false;
+
+    // FNV-1a, terminator included. A NUL can't occur inside a string, so it separates the
+    // chained parts and two different splits of the same text never give the same hash.
+    static uint64_t hash(const char* data, uint64_t seed) {
+        uint64_t value = seed;
+        const char* c = data;
+        do {
+            value ^= static_cast<unsigned char>(*c);
+            value *= 1099511628211ULL;
+        } while (*c++);
+        return value;
+    }
+
+    [[nodiscard]]
+    std::string pathFor(uint64_t key) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016" PRIx64 ".bin", key);
+        return mDirectory + name;
+    }
+
+public:
+    // Must be called with a current context; reads the driver identity
+    void initialize(const char* dataPath) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (!dataPath || formatCount <= 0) {
+            LOG_INFO("Program binary cache disabled");
+            mEnabled = false;
+            return;
+        }
+
+        mDirectory = std::string(dataPath) + "/program_cache";
+        mkdir(mDirectory.c_str(), 0700);
+
+        const auto* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        const auto* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        mDriverHash = hash(renderer ? renderer : "", 14695981039346656037ULL);
+        mDriverHash = hash(version ? version : "", mDriverHash);
+        mEnabled = true;
+    }
+
+    [[nodiscard]]
+    bool isEnabled() const {
+        return mEnabled;
+    }
+
+    // The variant key is folded in as well, so variants never share an entry
+    [[nodiscard]]
+    uint64_t key(const char* vertexSource, const char* fragmentSource, uint32_t variant = 0) const {
+        return (hash(fragmentSource, hash(vertexSource, mDriverHash)) ^ variant) * 1099511628211ULL;
+    }
+
+    // Returns a linked program, or 0 on a miss or when the driver rejects the blob
+    GLuint load(uint64_t key) const {
+        std::string path = pathFor(key);
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return 0;
+        }
+
+        Header header{};
+        std::vector<char> binary;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == kMagic && header.key == key;
+        if (valid) {
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file) - static_cast<long>(sizeof(header));
+            fseek(file, sizeof(header), SEEK_SET);
+            binary.resize(size > 0 ? static_cast<size_t>(size) : 0);
+            valid = !binary.empty() && fread(binary.data(), binary.size(), 1, file) == 1;
+        }
+        fclose(file);
+
+        GLuint program = 0;
+        if (valid) {
+            program = glCreateProgram();
+            glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+            GLint success;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            if (!success) {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+
+        if (!program) {
+            LOG_INFO("Discarding rejected program binary %s", path.c_str());
+            remove(path.c_str());
+        }
+        return program;
+    }
+
+    void store(GLuint program, uint64_t key) const {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        Header header{kMagic, 0, key};
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+        header.format = format;
+
+        // Write to a temporary file first so a crash never leaves a truncated entry behind
+        std::string path = pathFor(key);
+        std::string tempPath = path + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            LOG_ERROR("Failed to write program binary %s", tempPath.c_str());
+            return;
+        }
+
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(binary.data(), binary.size(), 1, file) == 1;
+        written = fclose(file) == 0 && written;
+        if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+            LOG_ERROR("Failed to write program binary %s", path.c_str());
+            remove(tempPath.c_str());
+        }
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+
+#include "GLStateCache.h"
+
+// Explicit render pass over one framebuffer, shaped for tiled GPUs.
+// begin() clears every attachment, so no tile is loaded from memory; end() invalidates
+// every attachment the pass doesn't store, so no tile is written back either. Anything
+// consumed inside the pass, such as a depth buffer or a multisampled target that was
+// resolved with a blit before end(), should not be stored.
+class RenderPass {
+public:
+    static constexpr uint32_t kColor = 1;
+    static constexpr uint32_t kDepth = 2;
+    static constexpr uint32_t kStencil = 4;
+
+private:
+    GLuint mFramebuffer = 0;
+    uint32_t mAttachments = kColor;
+    uint32_t mStored = kColor;
+    float mClearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    // Empty is the whole framebuffer
+    GLint mAreaX = 0;
+    GLint mAreaY = 0;
+    GLsizei mAreaWidth = 0;
+    GLsizei mAreaHeight = 0;
+
+public:
+    // Framebuffer 0 is the window surface
+    void setFramebuffer(GLuint framebuffer, uint32_t attachments) {
+        mFramebuffer = framebuffer;
+        mAttachments = attachments;
+    }
+
+    // Attachments that are still needed after end(), e.g. the colour that gets presented
+    void setStored(uint32_t attachments) {
+        mStored = attachments;
+    }
+
+    void setClearColor(float r, float g, float b, float a) {
+        mClearColor[0] = r;
+        mClearColor[1] = g;
+        mClearColor[2] = b;
+        mClearColor[3] = a;
+    }
+
+    // Restricts the pass to part of the framebuffer, e.g. to repaint only what changed.
+    // The pixels outside keep what the framebuffer held, so they must still be valid.
+    void setRenderArea(GLint x, GLint y, GLsizei width, GLsizei height) {
+        mAreaX = x;
+        mAreaY = y;
+        mAreaWidth = width;
+        mAreaHeight = height;
+    }
+
+    [[nodiscard]]
+    uint32_t attachments() const {
+        return mAttachments;
+    }
+
+    // Clears ignore the viewport but not the scissor or write masks.
+    // A render area stays scissored until end(), so draws stay inside it too.
+    void begin() const {
+        GLStateCache& state = GLStateCache::current();
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        bool partial = mAreaWidth > 0 && mAreaHeight > 0;
+        state.setScissorTest(partial);
+        if (partial) {
+            glScissor(mAreaX, mAreaY, mAreaWidth, mAreaHeight);
+        }
+
+        GLbitfield clearBits = 0;
+        if (mAttachments & kColor) {
+            state.clearColor(mClearColor[0], mClearColor[1], mClearColor[2], mClearColor[3]);
+            clearBits |= GL_COLOR_BUFFER_BIT;
+        }
+        if (mAttachments & kDepth) {
+            state.depthMask(true);
+            clearBits |= GL_DEPTH_BUFFER_BIT;
+        }
+        if (mAttachments & kStencil) {
+            // Nothing narrows the stencil write mask, which the state cache doesn't track
+            clearBits |= GL_STENCIL_BUFFER_BIT;
+        }
+        glClear(clearBits);
+    }
+
+    // Binds the pass's framebuffer again if there is anything to invalidate
+    void end() const {
+        // The window surface names its buffers differently from a framebuffer object
+        GLStateCache::current().setScissorTest(false);
+        const bool window = mFramebuffer == 0;
+        GLenum discard[3];
+        GLsizei count = 0;
+        uint32_t dropped = mAttachments & ~mStored;
+        if (dropped & kColor) {
+            discard[count++] = window ? GL_COLOR : GL_COLOR_ATTACHMENT0;
+        }
+        if (dropped & kDepth) {
+            discard[count++] = window ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+        }
+        if (dropped & kStencil) {
+            discard[count++] = window ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+        }
+        if (count == 0) {
+            return;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, count, discard);
+    }
+};
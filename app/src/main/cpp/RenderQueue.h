@@ -0,0 +1,311 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "GLStateCache.h"
+#include "Log.h"
+#include "ShaderProgram.h"
+#include "StreamBuffer.h"
+#include "Texture.h"
+#include "TriangleMesh.h"
+#include "UniformRing.h"
+
+// Per-frame queue of draw packets.
+// Objects submit small packets referring to registered programs, meshes and materials.
+// flush() radix-sorts them by a 64-bit key so program and VAO switches are minimised,
+// then merges runs that share program, mesh and material into one instanced draw,
+// with the instance data of the whole frame streamed through a single StreamBuffer.
+// The constants of every batch are written to a UniformRing in one pass as well, and
+// each draw only binds its block by offset.
+// Programs must use the instanced attribute layout and meshes need enableInstancing().
+// Batches whose program is still compiling or whose mesh or texture is still loading are skipped.
+class RenderQueue {
+public:
+    using Handle = uint16_t;
+    // Returned when a registration is rejected; packets using it are dropped
+    static constexpr Handle kInvalidHandle = 0xFFFF;
+
+    struct Material {
+        bool blend = false;  // Blended materials draw after opaque ones, back to front
+        float tint[4] = {1.0f, 1.0f, 1.0f, 1.0f};  // Multiplies the instance colours
+        // Sampled on unit 0 by textured programs; batches wait until its first levels are in
+        const StreamedTexture* texture = nullptr;
+    };
+
+    struct Stats {
+        uint32_t packets = 0;
+        uint32_t batches = 0;
+    };
+
+private:
+    // Key layout, most significant bit first:
+    //   opaque:      0 | program:12 | material:12 | mesh:15 | depth:24 (front to back)
+    //   translucent: 1 | ~depth:24 (back to front) | program:12 | material:12 | mesh:15
+    static constexpr uint32_t kHandleBits = 12;
+    static constexpr uint32_t kMeshBits = 15;
+    static constexpr uint32_t kDepthBits = 24;
+    static constexpr uint32_t kMaxHandles = 1u << kHandleBits;  // Programs and materials
+    static constexpr uint32_t kMaxMeshes = 1u << kMeshBits;
+    // Batches past this are dropped; merged runs keep real frames far below it
+    static constexpr uint32_t kMaxBatches = 1024;
+
+    struct Packet {
+        uint64_t key;
+        uint32_t instance;
+        Handle program;
+        Handle mesh;
+        Handle material;
+    };
+
+    // A run of sorted packets drawn as one instanced draw
+    struct Batch {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    std::vector<ShaderProgram*> mPrograms;
+    std::vector<TriangleMesh*> mMeshes;
+    std::vector<Material> mMaterials;
+
+    // Reused every frame, so steady-state submission doesn't allocate
+    std::vector<Packet> mPackets;
+    std::vector<Packet> mSortScratch;
+    std::vector<InstanceData> mInstances;
+    std::vector<Batch> mBatches;
+
+    StreamBuffer mInstanceStream;
+    UniformRing mUniforms;
+    FrameUniforms mFrameUniforms = kDefaultFrameUniforms;
+    uint32_t mMaxInstances = 0;
+    Stats mStats;
+    bool mOverflowLogged = false;
+    bool mBatchOverflowLogged = false;
+
+    // Handles past the key field's range would corrupt the sort order, so they are refused
+    template<typename T>
+    static Handle addHandle(std::vector<T>& registered, const T& value, uint32_t limit, const char* kind) {
+        if (registered.size() >= limit) {
+            LOG_ERROR("Render queue holds at most %u %s, rejecting another", limit, kind);
+            return kInvalidHandle;
+        }
+        registered.push_back(value);
+        return static_cast<Handle>(registered.size() - 1);
+    }
+
+    static uint64_t makeKey(Handle program, Handle mesh, Handle material, bool blend, float depth) {
+        float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+        auto quantized = static_cast<uint64_t>(clamped * ((1u << kDepthBits) - 1));
+        uint64_t state = (static_cast<uint64_t>(program) << (kHandleBits + kMeshBits)) |
+                         (static_cast<uint64_t>(material) << kMeshBits) | mesh;
+        if (blend) {
+            uint64_t backToFront = ((1u << kDepthBits) - 1) - quantized;
+            return (1ULL << 63) | (backToFront << (2 * kHandleBits + kMeshBits)) | state;
+        }
+        return (state << kDepthBits) | quantized;
+    }
+
+    // LSD radix sort, one byte per pass; passes where every key shares the byte are skipped
+    void sortPackets() {
+        size_t count = mPackets.size();
+        mSortScratch.resize(count);
+        Packet* source = mPackets.data();
+        Packet* destination = mSortScratch.data();
+
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = {};
+            for (size_t i = 0; i < count; ++i) {
+                ++histogram[(source[i].key >> shift) & 0xFF];
+            }
+            if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t& bucket : histogram) {
+                size_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+            }
+            std::swap(source, destination);
+        }
+
+        if (source != mPackets.data()) {
+            std::copy(source, source + count, mPackets.data());
+        }
+    }
+
+    void collectBatches() {
+        mBatches.clear();
+        size_t start = 0;
+        while (start < mPackets.size()) {
+            const Packet& first = mPackets[start];
+            size_t end = start + 1;
+            while (end < mPackets.size() && mPackets[end].program == first.program &&
+                   mPackets[end].mesh == first.mesh && mPackets[end].material == first.material) {
+                ++end;
+            }
+            if (mBatches.size() >= kMaxBatches) {
+                if (!mBatchOverflowLogged) {
+                    LOG_ERROR("Render queue full, dropping batches beyond %u per frame", kMaxBatches);
+                    mBatchOverflowLogged = true;
+                }
+                return;
+            }
+            mBatches.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(end)});
+            start = end;
+        }
+    }
+
+public:
+    RenderQueue() = default;
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // Registered objects must outlive the queue; registration survives context loss
+    Handle addProgram(ShaderProgram* program) {
+        return addHandle(mPrograms, program, kMaxHandles, "programs");
+    }
+
+    Handle addMesh(TriangleMesh* mesh) {
+        return addHandle(mMeshes, mesh, kMaxMeshes, "meshes");
+    }
+
+    Handle addMaterial(const Material& material) {
+        return addHandle(mMaterials, material, kMaxHandles, "materials");
+    }
+
+    // Must be called with a current context
+    bool initialize(uint32_t maxInstances) {
+        mMaxInstances = maxInstances;
+        mPackets.reserve(maxInstances);
+        mSortScratch.reserve(maxInstances);
+        mInstances.reserve(maxInstances);
+        mBatches.reserve(kMaxBatches);
+        return mInstanceStream.initialize(GL_ARRAY_BUFFER,
+                                          static_cast<GLsizeiptr>(maxInstances * sizeof(InstanceData))) &&
+               mUniforms.initialize(kMaxBatches + 1, sizeof(FrameUniforms));
+    }
+
+    // Column major; applies to every draw from the next flush() on
+    void setViewProjection(const float matrix[16]) {
+        std::copy(matrix, matrix + 16, mFrameUniforms.viewProjection);
+    }
+
+    void submit(Handle program, Handle mesh, Handle material, float depth, const InstanceData& instance) {
+        // An unregistered handle would spill into the neighbouring key fields
+        if (program >= mPrograms.size() || mesh >= mMeshes.size() || material >= mMaterials.size()) {
+            return;
+        }
+        if (mPackets.size() >= mMaxInstances) {
+            if (!mOverflowLogged) {
+                LOG_ERROR("Render queue full, dropping draws beyond %u per frame", mMaxInstances);
+                mOverflowLogged = true;
+            }
+            return;
+        }
+
+        auto index = static_cast<uint32_t>(mInstances.size());
+        mInstances.push_back(instance);
+        mPackets.push_back({makeKey(program, mesh, material, mMaterials[material].blend, depth), index,
+                            program, mesh, material});
+    }
+
+    void flush() {
+        mStats = {};
+        mStats.packets = static_cast<uint32_t>(mPackets.size());
+        if (mPackets.empty()) {
+            return;
+        }
+
+        sortPackets();
+
+        // Lay the instance data out in sorted order so every batch is one contiguous range
+        mInstanceStream.beginFrame();
+        mUniforms.beginFrame();
+        StreamBuffer::Allocation allocation =
+                mInstanceStream.allocate(static_cast<GLsizeiptr>(mPackets.size() * sizeof(InstanceData)));
+        if (allocation.data) {
+            auto* instances = static_cast<InstanceData*>(allocation.data);
+            for (size_t i = 0; i < mPackets.size(); ++i) {
+                instances[i] = mInstances[mPackets[i].instance];
+            }
+            mInstanceStream.commit(allocation);
+            collectBatches();
+
+            // Write every batch's constants up front, so each draw only binds an offset
+            StreamBuffer::Allocation frameUniforms = mUniforms.allocate(sizeof(FrameUniforms));
+            if (frameUniforms.data) {
+                *mUniforms.element<FrameUniforms>(frameUniforms, 0) = mFrameUniforms;
+                mUniforms.commit(frameUniforms);
+            }
+            StreamBuffer::Allocation batchUniforms = mUniforms.allocate(sizeof(BatchUniforms), mBatches.size());
+            if (batchUniforms.data) {
+                for (size_t i = 0; i < mBatches.size(); ++i) {
+                    const Material& material = mMaterials[mPackets[mBatches[i].start].material];
+                    std::copy(material.tint, material.tint + 4,
+                              mUniforms.element<BatchUniforms>(batchUniforms, i)->tint);
+                }
+                mUniforms.commit(batchUniforms);
+            }
+
+            if (frameUniforms.data && batchUniforms.data) {
+                GLStateCache& state = GLStateCache::current();
+                mUniforms.bind(UniformBlock::Frame, frameUniforms, 0, sizeof(FrameUniforms));
+                for (size_t i = 0; i < mBatches.size(); ++i) {
+                    const Batch& batch = mBatches[i];
+                    const Packet& first = mPackets[batch.start];
+                    ShaderProgram* program = mPrograms[first.program];
+                    TriangleMesh* mesh = mMeshes[first.mesh];
+                    const Material& material = mMaterials[first.material];
+                    if (!program->isReady() || !mesh->isReady() || (material.texture && !material.texture->isReady())) {
+                        continue;
+                    }
+
+                    state.setBlend(material.blend);
+                    if (material.blend) {
+                        state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    }
+                    if (material.texture) {
+                        material.texture->texture().bind(0);
+                    }
+                    program->use();
+                    mUniforms.bind(UniformBlock::Batch, batchUniforms, i, sizeof(BatchUniforms));
+
+                    mesh->bindInstanceSource(mInstanceStream.buffer(),
+                                             allocation.offset + static_cast<GLintptr>(batch.start * sizeof(InstanceData)));
+                    mesh->drawInstanced(static_cast<GLsizei>(batch.end - batch.start));
+                    ++mStats.batches;
+                }
+                state.setBlend(false);
+            }
+        }
+        mUniforms.endFrame();
+        mInstanceStream.endFrame();
+
+        mPackets.clear();
+        mInstances.clear();
+    }
+
+    // Counts for the last flush()
+    [[nodiscard]]
+    Stats stats() const {
+        return mStats;
+    }
+
+    void cleanup() {
+        mInstanceStream.cleanup();
+        mUniforms.cleanup();
+    }
+
+    void invalidate() {
+        mInstanceStream.invalidate();
+        mUniforms.invalidate();
+    }
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <android_native_app_glue.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "FramePacer.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "PerformanceHint.h"
+#include "SpscQueue.h"
+#include "ThermalMonitor.h"
+#include "TouchInput.h"
+
+// Commands sent from the android_main event loop to the render thread
+struct RenderCommand {
+    enum class Type {
+        InitWindow,
+        TermWindow,
+        Resize,
+        Pause,
+        Resume,
+        Quit
+    };
+
+    Type type = Type::Quit;
+    ANativeWindow* window = nullptr;
+};
+
+// Window colour depth; 565 halves the bandwidth of every pixel written and presented
+enum class ColorFormat {
+    Rgb888,
+    Rgb565
+};
+
+inline ColorFormat colorFormatFromString(const char* value) {
+    return strcmp(value, "565") == 0 ? ColorFormat::Rgb565 : ColorFormat::Rgb888;
+}
+
+// Renderer interface
+// Owns a render thread and the command ring the event loop talks to it through; a
+// backend implements the virtual hooks, all of which run on that thread. The thread
+// calls into the backend, so every backend's destructor has to call stop() itself.
+// It also reports frame work to the performance hint session and backs off when the
+// device heats up: the pacer halves the frame rate, backends may shed more themselves.
+class Renderer {
+protected:
+    android_app* mApp = nullptr;
+    JobSystem& mJobs;
+    FramePacer mFramePacer;
+    FrustumCuller mCuller;
+    // Filled by onInputEvent() for backends that set mInputEnabled in their constructor
+    TouchInput mInput;
+    bool mInputEnabled = false;
+    bool mHudEnabled = false;
+    bool mGpuCulling = false;
+    uint32_t mBenchmarkFrames = 0;
+    float mMinResolutionScale = 1.0f;
+    float mMaxResolutionScale = 1.0f;
+    ColorFormat mColorFormat = ColorFormat::Rgb888;
+    bool mVisible = false;
+    bool mQuit = false;
+
+    // Creates the window surface, and on first use the device and GPU resources
+    virtual bool attachWindow(ANativeWindow* window) = 0;
+    // Drops only the window surface
+    virtual void detachWindow() = 0;
+    virtual void resize() = 0;
+    virtual void drawFrame() = 0;
+    // Tears everything down before the render thread exits
+    virtual void cleanup() = 0;
+    [[nodiscard]]
+    virtual bool isReadyToDraw() const = 0;
+    // Runs once on the render thread before the first command is handled
+    virtual void onRenderThreadStarted() {}
+    // Long work split into steps, one per pass of the render loop while no frame is due,
+    // so commands are still handled in between. Called until it returns false.
+    virtual bool runBackgroundStep() { return false; }
+    // Runs before the frame after the thermal pressure changed
+    virtual void onThermalPressureChanged(ThermalMonitor::Pressure /*pressure*/) {}
+
+    // Same clock as input event times
+    static int64_t nowNanos() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    // Backends call this right before presenting, so waits for the display aren't counted as work
+    void endFrameWork() {
+        mPerformanceHint.reportWork(nowNanos() - mFrameWorkStartNs, mFramePacer.framePeriodNs());
+    }
+
+    Renderer(android_app* app, JobSystem& jobs) : mApp(app), mJobs(jobs) {}
+
+private:
+    std::thread mThread;
+    std::atomic<ALooper*> mLooper{nullptr};
+    SpscQueue<RenderCommand, 64> mCommands;
+    uint64_t mSubmittedCommands = 0;
+    std::atomic<uint64_t> mCompletedCommands{0};
+    PerformanceHint mPerformanceHint;
+    ThermalMonitor mThermal;
+    ThermalMonitor::Pressure mThermalPressure = ThermalMonitor::Pressure::None;
+    int64_t mFrameWorkStartNs = 0;
+    bool mBackgroundWork = true;  // Until runBackgroundStep() says there is none left
+
+    [[nodiscard]]
+    bool isFrameDue() const {
+        return mVisible && isReadyToDraw() && mFramePacer.isFrameDue();
+    }
+
+    void handleCommand(const RenderCommand& command) {
+        switch (command.type) {
+            case RenderCommand::Type::InitWindow: {
+                if (!attachWindow(command.window)) {
+                    detachWindow();
+                }
+                break;
+            }
+
+            case RenderCommand::Type::TermWindow: {
+                detachWindow();
+                break;
+            }
+
+            case RenderCommand::Type::Resize: {
+                if (isReadyToDraw()) {
+                    resize();
+                }
+                break;
+            }
+
+            case RenderCommand::Type::Pause: {
+                mVisible = false;
+                break;
+            }
+
+            case RenderCommand::Type::Resume: {
+                mVisible = true;
+                break;
+            }
+
+            case RenderCommand::Type::Quit: {
+                mQuit = true;
+                break;
+            }
+        }
+
+        updateFramePacing();
+    }
+
+    // Vsync callbacks only keep coming while there is something to draw
+    void updateFramePacing() {
+        if (mVisible && isReadyToDraw()) {
+            mFramePacer.start();
+        } else {
+            mFramePacer.stop();
+        }
+    }
+
+    // The session covers the render thread and every worker that records for it
+    void startDeviceMonitoring() {
+        std::vector<int32_t> threads = mJobs.workerThreadIds();
+        threads.push_back(gettid());
+        mPerformanceHint.initialize(threads, mFramePacer.framePeriodNs());
+        mThermal.initialize();
+    }
+
+    void updateThermalPressure() {
+        ThermalMonitor::Pressure pressure = mThermal.poll();
+        if (pressure == mThermalPressure) {
+            return;
+        }
+        mThermalPressure = pressure;
+        mFramePacer.setThrottled(pressure == ThermalMonitor::Pressure::Hot);
+        onThermalPressureChanged(pressure);
+    }
+
+    void renderLoop() {
+        pthread_setname_np(pthread_self(), "RenderThread");
+        mJobs.registerThread();
+        mLooper.store(ALooper_prepare(0), std::memory_order_release);
+        mFramePacer.initialize();
+        startDeviceMonitoring();
+        onRenderThreadStarted();
+
+        while (!mQuit) {
+            // Block until a command or vsync callback wakes the looper while no frame is due
+            int events;
+            void* data;
+            ALooper_pollOnce(isFrameDue() || mBackgroundWork ? 0 : -1, nullptr, &events, &data);
+
+            RenderCommand command;
+            while (mCommands.pop(command)) {
+                handleCommand(command);
+                mCompletedCommands.fetch_add(1, std::memory_order_release);
+            }
+
+            if (isFrameDue()) {
+                updateThermalPressure();
+                mFrameWorkStartNs = nowNanos();
+                drawFrame();
+                // A frame can lose the surface, e.g. when the swap fails
+                updateFramePacing();
+            } else if (mBackgroundWork) {
+                mBackgroundWork = runBackgroundStep();
+            }
+        }
+
+        cleanup();
+        mPerformanceHint.cleanup();
+        mThermal.cleanup();
+    }
+
+    uint64_t submit(const RenderCommand& command) {
+        // Commands are rare, so a full ring only ever waits for the render thread to catch up
+        while (!mCommands.push(command)) {
+            std::this_thread::yield();
+        }
+        ALooper_wake(mLooper.load(std::memory_order_acquire));
+        return ++mSubmittedCommands;
+    }
+
+    void waitForCommand(uint64_t sequence) const {
+        while (mCompletedCommands.load(std::memory_order_acquire) < sequence) {
+            std::this_thread::yield();
+        }
+    }
+
+public:
+    virtual ~Renderer() = default;
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // Must be called before start()
+    void setFrameRate(FrameRate rate) {
+        mFramePacer.setFrameRate(rate);
+    }
+
+    // Must be called before start()
+    void setHudEnabled(bool enabled) {
+        mHudEnabled = enabled;
+    }
+
+    // Must be called before start()
+    void setCullingKernel(FrustumCuller::Kernel kernel) {
+        mCuller.setKernel(kernel);
+        LOG_INFO("Frustum culling: %s", FrustumCuller::kernelName(kernel));
+    }
+
+    // Must be called before start(); culls and draws the scene with compute and indirect
+    // draws instead of recording it on the workers. GLES only, Vulkan logs it and culls on the CPU
+    void setGpuCulling(bool enabled) {
+        mGpuCulling = enabled;
+    }
+
+    // Must be called before start(); extrapolates drags to when the frame is expected on screen
+    void setTouchPrediction(bool enabled) {
+        mInput.setPrediction(enabled);
+    }
+
+    // Must be called before start()
+    void setColorFormat(ColorFormat format) {
+        mColorFormat = format;
+    }
+
+    // Must be called before start(); a minimum below 1.0 lets the scene resolution drop with GPU load.
+    // GLES only, Vulkan logs it and draws at full resolution
+    void setResolutionScale(float minScale, float maxScale) {
+        mMinResolutionScale = minScale;
+        mMaxResolutionScale = maxScale;
+    }
+
+    // Must be called before start(); zero runs the interactive scene
+    void setBenchmarkFrames(uint32_t frames) {
+        mBenchmarkFrames = frames;
+    }
+
+    void start() {
+        mThread = std::thread(&Renderer::renderLoop, this);
+        while (!mLooper.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void stop() {
+        if (!mThread.joinable()) {
+            return;
+        }
+        submit({RenderCommand::Type::Quit});
+        mThread.join();
+    }
+
+    void onWindowCreated(ANativeWindow* window) {
+        submit({RenderCommand::Type::InitWindow, window});
+    }
+
+    // The glue releases the window once the command returns, so wait for the render thread
+    void onWindowDestroyed() {
+        waitForCommand(submit({RenderCommand::Type::TermWindow}));
+    }
+
+    void onWindowResized() {
+        submit({RenderCommand::Type::Resize});
+    }
+
+    void setVisible(bool visible) {
+        submit({visible ? RenderCommand::Type::Resume : RenderCommand::Type::Pause});
+    }
+
+    // Called from the glue for each input event; the render thread picks the samples up itself
+    int32_t onInputEvent(const AInputEvent* event) {
+        return mInputEnabled ? mInput.handleEvent(event) : 0;
+    }
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Log.h"
+#include "VulkanFunctions.h"
+
+// SPIR-V counterpart of ShaderProgram for the Vulkan renderer.
+// The code comes from SpirvShaders.h, which the build compiles from the same GLSL in
+// Shaders.h that ShaderProgram builds, so both backends always run the same shaders.
+class ShaderModule {
+private:
+    const VulkanFunctions* mVk = nullptr;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkShaderModule mModule = VK_NULL_HANDLE;
+
+public:
+    ShaderModule() = default;
+    ~ShaderModule() {
+        cleanup();
+    }
+
+    ShaderModule(const ShaderModule&) = delete;
+    ShaderModule& operator=(const ShaderModule&) = delete;
+
+    bool initialize(const VulkanFunctions& vk, VkDevice device, const uint32_t* code, size_t size) {
+        VkShaderModuleCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = size;
+        createInfo.pCode = code;
+        if (vk.vkCreateShaderModule(device, &createInfo, nullptr, &mModule) != VK_SUCCESS) {
+            LOG_ERROR("Failed to create shader module");
+            mModule = VK_NULL_HANDLE;
+            return false;
+        }
+        mVk = &vk;
+        mDevice = device;
+        return true;
+    }
+
+    // Modules are only needed while pipelines are created from them
+    void cleanup() {
+        if (mModule != VK_NULL_HANDLE) {
+            mVk->vkDestroyShaderModule(mDevice, mModule, nullptr);
+            mModule = VK_NULL_HANDLE;
+        }
+    }
+
+    [[nodiscard]]
+    VkShaderModule get() const {
+        return mModule;
+    }
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "Log.h"
+#include "ProgramCache.h"
+#include "Uniforms.h"
+
+// Shader utility class
+// Programs are built in two steps: submit() issues the compile and link without
+// reading any status back, and the status is only queried once the program is
+// first used, so driver compiler threads can work while earlier frames render.
+// Once linked, uniform blocks are found by name and given their fixed binding points.
+// A deferred program doesn't even submit until then, so unused ones are never built.
+class ShaderProgram {
+private:
+    GLuint mProgramId = 0;
+    GLuint mVertexShader = 0;
+    GLuint mFragmentShader = 0;
+    bool mPending = false;
+    bool mParallel = false;
+    const ProgramCache* mCache = nullptr;
+    uint64_t mCacheKey = 0;
+    // Set by defer() until the build is submitted
+    const char* mDeferredVertexSource = nullptr;
+    const char* mDeferredFragmentSource = nullptr;
+    uint32_t mVariant = 0;
+
+    static GLuint createShader(GLenum type, const char* source) {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    static void logCompileError(GLuint shader) {
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+            LOG_ERROR("Shader compilation error: %s", infoLog);
+        }
+    }
+
+    // Reflection runs on every usable program, since block bindings aren't part of a cached binary
+    void bindUniformBlocks() {
+        GLint blockCount = 0;
+        glGetProgramiv(mProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        for (GLint i = 0; i < blockCount; ++i) {
+            auto index = static_cast<GLuint>(i);
+            char name[64];
+            glGetActiveUniformBlockName(mProgramId, index, sizeof(name), nullptr, name);
+            UniformBlock block;
+            if (!uniformBlockFromName(name, block)) {
+                LOG_ERROR("Uniform block %s has no binding point", name);
+                continue;
+            }
+
+            GLint size = 0;
+            glGetActiveUniformBlockiv(mProgramId, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            if (static_cast<size_t>(size) != kUniformBlockSizes[static_cast<size_t>(block)]) {
+                LOG_ERROR("Uniform block %s is %d bytes, expected %zu", name, size,
+                          kUniformBlockSizes[static_cast<size_t>(block)]);
+            }
+            glUniformBlockBinding(mProgramId, index, static_cast<GLuint>(block));
+        }
+    }
+
+    void deleteShaders() {
+        if (mVertexShader) {
+            glDeleteShader(mVertexShader);
+            mVertexShader = 0;
+        }
+        if (mFragmentShader) {
+            glDeleteShader(mFragmentShader);
+            mFragmentShader = 0;
+        }
+    }
+
+public:
+    struct BuildRequest {
+        ShaderProgram* program;
+        const char* vertexSource;
+        const char* fragmentSource;
+        uint32_t variant = 0;  // Feature flags of a shader variant, part of the cache key
+    };
+
+    ShaderProgram() = default;
+    ~ShaderProgram() {
+        cleanup();
+    }
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Turns on driver compiler threads; returns whether completion can be polled without stalling
+    static bool enableParallelCompile() {
+        if (!hasGLExtension("GL_KHR_parallel_shader_compile")) {
+            return false;
+        }
+
+        auto maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+                eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if (maxShaderCompilerThreads) {
+            maxShaderCompilerThreads(0xFFFFFFFF);
+        }
+        return true;
+    }
+
+    // Issues every compile before any link so the driver can overlap them
+    static void submitBatch(const BuildRequest* requests, size_t count, const ProgramCache* cache, bool parallel) {
+        for (size_t i = 0; i < count; ++i) {
+            ShaderProgram& program = *requests[i].program;
+            program.cleanup();
+            program.mParallel = parallel;
+            program.mCache = cache && cache->isEnabled() ? cache : nullptr;
+
+            // Try the driver's binary from a previous run before compiling from source
+            if (program.mCache) {
+                program.mCacheKey = cache->key(requests[i].vertexSource, requests[i].fragmentSource,
+                                               requests[i].variant);
+                program.mProgramId = cache->load(program.mCacheKey);
+                if (program.mProgramId) {
+                    program.bindUniformBlocks();
+                    continue;
+                }
+            }
+
+            program.mVertexShader = createShader(GL_VERTEX_SHADER, requests[i].vertexSource);
+            program.mFragmentShader = createShader(GL_FRAGMENT_SHADER, requests[i].fragmentSource);
+            program.mPending = true;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            ShaderProgram& program = *requests[i].program;
+            if (!program.mPending) {
+                continue;
+            }
+
+            program.mProgramId = glCreateProgram();
+            glAttachShader(program.mProgramId, program.mVertexShader);
+            glAttachShader(program.mProgramId, program.mFragmentShader);
+            if (program.mCache) {
+                glProgramParameteri(program.mProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            glLinkProgram(program.mProgramId);
+        }
+    }
+
+    void submit(const char* vertexSource, const char* fragmentSource, const ProgramCache* cache, bool parallel,
+                uint32_t variant = 0) {
+        BuildRequest request{this, vertexSource, fragmentSource, variant};
+        submitBatch(&request, 1, cache, parallel);
+    }
+
+    // Remembers the sources and submits them the first time the program is used.
+    // The sources must outlive the program.
+    void defer(const char* vertexSource, const char* fragmentSource, const ProgramCache* cache, bool parallel,
+               uint32_t variant = 0) {
+        cleanup();
+        mDeferredVertexSource = vertexSource;
+        mDeferredFragmentSource = fragmentSource;
+        mCache = cache;
+        mParallel = parallel;
+        mVariant = variant;
+    }
+
+    [[nodiscard]]
+    bool isDeferred() const {
+        return mDeferredVertexSource != nullptr;
+    }
+
+    void submitDeferred() {
+        if (isDeferred()) {
+            submit(mDeferredVertexSource, mDeferredFragmentSource, mCache, mParallel, mVariant);
+        }
+    }
+
+    // Blocking build, for callers that need the program straight away
+    bool initialize(const char* vertexSource, const char* fragmentSource, const ProgramCache* cache = nullptr) {
+        submit(vertexSource, fragmentSource, cache, false);
+        return finalize();
+    }
+
+    // Blocks until the link finishes; returns whether the program is usable
+    bool finalize() {
+        submitDeferred();
+        if (!mPending) {
+            return mProgramId != 0;
+        }
+        mPending = false;
+
+        GLint success;
+        glGetProgramiv(mProgramId, GL_LINK_STATUS, &success);
+        if (!success) {
+            logCompileError(mVertexShader);
+            logCompileError(mFragmentShader);
+
+            char infoLog[512];
+            glGetProgramInfoLog(mProgramId, 512, nullptr, infoLog);
+            LOG_ERROR("Program link error: %s", infoLog);
+            glDeleteProgram(mProgramId);
+            mProgramId = 0;
+        } else {
+            bindUniformBlocks();
+            if (mCache) {
+                mCache->store(mProgramId, mCacheKey);
+            }
+        }
+
+        deleteShaders();
+        return mProgramId != 0;
+    }
+
+    // Non-blocking where GL_KHR_parallel_shader_compile is available
+    bool isReady() {
+        submitDeferred();
+        if (mPending && mParallel) {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(mProgramId, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete) {
+                return false;
+            }
+        }
+        return finalize();
+    }
+
+    void cleanup() {
+        deleteShaders();
+        if (mProgramId) {
+            GLStateCache::current().onProgramDeleted(mProgramId);
+            glDeleteProgram(mProgramId);
+            mProgramId = 0;
+        }
+        mPending = false;
+        mDeferredVertexSource = nullptr;
+        mDeferredFragmentSource = nullptr;
+    }
+
+    // Forget the program without deleting it, for when its context is already gone
+    void invalidate() {
+        mProgramId = 0;
+        mVertexShader = 0;
+        mFragmentShader = 0;
+        mPending = false;
+        mDeferredVertexSource = nullptr;
+        mDeferredFragmentSource = nullptr;
+    }
+
+    void use() const {
+        GLStateCache::current().useProgram(mProgramId);
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "ProgramCache.h"
+#include "ShaderProgram.h"
+#include "Shaders.h"
+
+// Feature flags a shader variant is built from; the combined flags are its variant key
+namespace ShaderFeature {
+    constexpr uint32_t kInstanced = 1;      // Instance transform and colour plus the uniform blocks
+    constexpr uint32_t kTextured = 2;       // Texture coordinates, sampling texture unit 0
+    constexpr uint32_t kHighPrecision = 4;  // highp instead of mediump in the fragment shader
+    constexpr uint32_t kVariantCount = 8;
+}
+
+// Fixed-size GLSL text that can be assembled in constant expressions
+template<size_t N>
+struct ShaderText {
+    char text[N + 1] = {};
+
+    constexpr ShaderText() = default;
+
+    constexpr ShaderText(const char (&literal)[N + 1]) {
+        for (size_t i = 0; i < N; ++i) {
+            text[i] = literal[i];
+        }
+    }
+
+    [[nodiscard]]
+    constexpr const char* c_str() const {
+        return text;
+    }
+};
+
+template<size_t N>
+ShaderText(const char (&)[N]) -> ShaderText<N - 1>;
+
+template<size_t A, size_t B>
+constexpr ShaderText<A + B> operator+(const ShaderText<A>& first, const ShaderText<B>& second) {
+    ShaderText<A + B> result;
+    for (size_t i = 0; i < A; ++i) {
+        result.text[i] = first.text[i];
+    }
+    for (size_t i = 0; i < B; ++i) {
+        result.text[A + i] = second.text[i];
+    }
+    return result;
+}
+
+// The text only when the feature is on
+template<bool Enabled, size_t N>
+constexpr auto shaderTextIf(const char (&literal)[N]) {
+    if constexpr (Enabled) {
+        return ShaderText<N - 1>(literal);
+    } else {
+        return ShaderText<0>();
+    }
+}
+
+template<bool Enabled, size_t N, size_t M>
+constexpr auto shaderTextChoose(const char (&enabled)[N], const char (&disabled)[M]) {
+    if constexpr (Enabled) {
+        return ShaderText<N - 1>(enabled);
+    } else {
+        return ShaderText<M - 1>(disabled);
+    }
+}
+
+constexpr bool sameShaderText(const char* first, const char* second) {
+    for (; *first || *second; ++first, ++second) {
+        if (*first != *second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The sources of one variant, assembled while compiling so no variant is hand-written
+template<uint32_t Features>
+struct ShaderVariant {
+    static constexpr bool kInstanced = (Features & ShaderFeature::kInstanced) != 0;
+    static constexpr bool kTextured = (Features & ShaderFeature::kTextured) != 0;
+    static constexpr bool kHighPrecision = (Features & ShaderFeature::kHighPrecision) != 0;
+
+    static constexpr auto vertexSource =
+            ShaderText("#version 320 es\n"
+                       "    layout(location = 0) in vec3 aPos;\n") +
+            shaderTextIf<kInstanced>(
+                    "    layout(location = 1) in mat4 aTransform;\n"
+                    "    layout(location = 5) in vec4 aColor;\n") +
+            shaderTextIf<kTextured>(
+                    "    layout(location = 7) in vec2 aTexCoord;\n") +
+            shaderTextIf<kInstanced>(
+                    "    #ifdef VULKAN\n"
+                    "    layout(push_constant) uniform FrameUniforms {\n"
+                    "    #else\n"
+                    "    layout(std140) uniform FrameUniforms {\n"
+                    "    #endif\n"
+                    "        mat4 viewProjection;\n"
+                    "    } uFrame;\n"
+                    "    out vec4 vColor;\n") +
+            shaderTextIf<kTextured>(
+                    "    out vec2 vTexCoord;\n") +
+            ShaderText("    void main() {\n") +
+            shaderTextIf<kInstanced>(
+                    "        vColor = aColor;\n") +
+            shaderTextIf<kTextured>(
+                    "        vTexCoord = aTexCoord;\n") +
+            shaderTextChoose<kInstanced>(
+                    "        gl_Position = uFrame.viewProjection * aTransform * vec4(aPos, 1.0);\n",
+                    "        gl_Position = vec4(aPos, 1.0);\n") +
+            ShaderText("    }");
+
+    static constexpr auto fragmentSource =
+            ShaderText("#version 320 es\n") +
+            shaderTextChoose<kHighPrecision>(
+                    "    precision highp float;\n",
+                    "    precision mediump float;\n") +
+            shaderTextIf<kInstanced>(
+                    "    #ifdef VULKAN\n"
+                    "    layout(push_constant) uniform BatchUniforms {\n"
+                    "        layout(offset = 64) vec4 tint;\n"
+                    "    } uBatch;\n"
+                    "    #else\n"
+                    "    layout(std140) uniform BatchUniforms {\n"
+                    "        vec4 tint;\n"
+                    "    } uBatch;\n"
+                    "    #endif\n"
+                    "    in vec4 vColor;\n") +
+            shaderTextIf<kTextured>(
+                    "    layout(binding = 0) uniform sampler2D uTexture;\n"
+                    "    in vec2 vTexCoord;\n") +
+            ShaderText("    out vec4 FragColor;\n"
+                       "    void main() {\n") +
+            shaderTextChoose<kInstanced>(
+                    "        FragColor = vColor * uBatch.tint",
+                    "        FragColor = vec4(0.0, 1.0, 0.0, 1.0)") +
+            shaderTextIf<kTextured>(" * texture(uTexture, vTexCoord)") +
+            ShaderText(";\n"
+                       "    }");
+};
+
+// The hand-written sources are what SPIR-V is built from, so the matching variants must not drift
+static_assert(sameShaderText(ShaderVariant<0>::vertexSource.c_str(), Shaders::vertexShaderSource) &&
+              sameShaderText(ShaderVariant<0>::fragmentSource.c_str(), Shaders::fragmentShaderSource),
+              "The plain variant must match Shaders.h");
+static_assert(sameShaderText(ShaderVariant<ShaderFeature::kInstanced>::vertexSource.c_str(),
+                             Shaders::instancedVertexShaderSource) &&
+              sameShaderText(ShaderVariant<ShaderFeature::kInstanced>::fragmentSource.c_str(),
+                             Shaders::instancedFragmentShaderSource),
+              "The instanced variant must match Shaders.h");
+
+struct ShaderVariantSources {
+    const char* vertex;
+    const char* fragment;
+};
+
+template<size_t... Features>
+constexpr std::array<ShaderVariantSources, sizeof...(Features)> makeShaderVariantTable(std::index_sequence<Features...>) {
+    return {{{ShaderVariant<Features>::vertexSource.c_str(), ShaderVariant<Features>::fragmentSource.c_str()}...}};
+}
+
+// Every variant's sources, indexed by variant key
+inline constexpr auto kShaderVariantSources =
+        makeShaderVariantTable(std::make_index_sequence<ShaderFeature::kVariantCount>());
+
+// One program slot per variant.
+// Slots are handed out freely, e.g. registered with a RenderQueue, but a variant is
+// only compiled once something draws with it or it is prewarmed.
+class ShaderVariantSet {
+private:
+    ShaderProgram mPrograms[ShaderFeature::kVariantCount];
+    const ProgramCache* mCache = nullptr;
+    bool mParallel = false;
+
+public:
+    ShaderVariantSet() = default;
+
+    ShaderVariantSet(const ShaderVariantSet&) = delete;
+    ShaderVariantSet& operator=(const ShaderVariantSet&) = delete;
+
+    // Must be called with a current context and again after the context is lost; builds nothing
+    void initialize(const ProgramCache* cache, bool parallel) {
+        mCache = cache;
+        mParallel = parallel;
+        for (uint32_t features = 0; features < ShaderFeature::kVariantCount; ++features) {
+            const ShaderVariantSources& sources = kShaderVariantSources[features];
+            mPrograms[features].defer(sources.vertex, sources.fragment, cache, parallel, features);
+        }
+    }
+
+    // Starts building variants that are known to be drawn soon, all in one batch
+    void prewarm(const uint32_t* features, size_t count) {
+        ShaderProgram::BuildRequest requests[ShaderFeature::kVariantCount];
+        size_t requestCount = 0;
+        uint32_t queued = 0;
+        for (size_t i = 0; i < count; ++i) {
+            // Already submitted by an earlier draw, or a repeat in the list
+            uint32_t bit = 1u << features[i];
+            if (!mPrograms[features[i]].isDeferred() || (queued & bit)) {
+                continue;
+            }
+            queued |= bit;
+            const ShaderVariantSources& sources = kShaderVariantSources[features[i]];
+            requests[requestCount++] = {&mPrograms[features[i]], sources.vertex, sources.fragment, features[i]};
+        }
+        ShaderProgram::submitBatch(requests, requestCount, mCache, mParallel);
+    }
+
+    ShaderProgram* program(uint32_t features) {
+        return &mPrograms[features];
+    }
+
+    void cleanup() {
+        for (ShaderProgram& program : mPrograms) {
+            program.cleanup();
+        }
+    }
+
+    void invalidate() {
+        for (ShaderProgram& program : mPrograms) {
+            program.invalidate();
+        }
+    }
+};
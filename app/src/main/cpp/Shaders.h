@@ -0,0 +1,58 @@
+#pragma once
+
+// Shader source code
+// Written out in full for tools/spirv_embed.py; ShaderVariants.h assembles the same text
+// along with the other feature combinations and checks the two agree.
+namespace Shaders {
+    // Vertex shader source
+    constexpr char vertexShaderSource[] = R"(#version 320 es
+    layout(location = 0) in vec3 aPos;
+    void main() {
+        gl_Position = vec4(aPos, 1.0);
+    })";
+
+    // Fragment shader source
+    constexpr char fragmentShaderSource[] = R"(#version 320 es
+    precision mediump float;
+    out vec4 FragColor;
+    void main() {
+        FragColor = vec4(0.0, 1.0, 0.0, 1.0);
+    })";
+
+    // Instanced vertex shader source, attribute locations match TriangleMesh.
+    // The uniform blocks match Uniforms.h; Vulkan takes them as push constants instead.
+    constexpr char instancedVertexShaderSource[] = R"(#version 320 es
+    layout(location = 0) in vec3 aPos;
+    layout(location = 1) in mat4 aTransform;
+    layout(location = 5) in vec4 aColor;
+    #ifdef VULKAN
+    layout(push_constant) uniform FrameUniforms {
+    #else
+    layout(std140) uniform FrameUniforms {
+    #endif
+        mat4 viewProjection;
+    } uFrame;
+    out vec4 vColor;
+    void main() {
+        vColor = aColor;
+        gl_Position = uFrame.viewProjection * aTransform * vec4(aPos, 1.0);
+    })";
+
+    // Fragment shader source for per-instance colors, tinted per batch
+    constexpr char instancedFragmentShaderSource[] = R"(#version 320 es
+    precision mediump float;
+    #ifdef VULKAN
+    layout(push_constant) uniform BatchUniforms {
+        layout(offset = 64) vec4 tint;
+    } uBatch;
+    #else
+    layout(std140) uniform BatchUniforms {
+        vec4 tint;
+    } uBatch;
+    #endif
+    in vec4 vColor;
+    out vec4 FragColor;
+    void main() {
+        FragColor = vColor * uBatch.tint;
+    })";
+}
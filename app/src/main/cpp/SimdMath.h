@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+// Four-wide float operations, NEON on the arm ABIs and SSE on x86, chosen at compile time.
+// Loads and stores are unaligned so they work on strided vertex and instance arrays.
+namespace simd {
+
+#if defined(__ARM_NEON)
+using float4 = float32x4_t;
+
+inline float4 load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+inline float4 splat(float v) { return vdupq_n_f32(v); }
+inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+// a * b + c; vmlaq rather than vfmaq so armeabi-v7a builds too
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+
+inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) {
+    float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+constexpr const char* kName = "neon";
+#elif defined(__SSE2__)
+using float4 = __m128;
+
+inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+inline float4 splat(float v) { return _mm_set1_ps(v); }
+inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+
+constexpr const char* kName = "sse2";
+#else
+struct float4 {
+    float v[4];
+};
+
+inline float4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, float4 a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+inline float4 splat(float s) { return {{s, s, s, s}}; }
+inline float4 add(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline float4 sub(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+inline float4 mul(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+
+inline void transpose(float4& r0, float4& r1, float4& r2, float4& r3) {
+    float4 rows[4] = {r0, r1, r2, r3};
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            (r == 0 ? r0 : r == 1 ? r1 : r == 2 ? r2 : r3).v[c] = rows[c].v[r];
+        }
+    }
+}
+
+constexpr const char* kName = "scalar";
+#endif
+
+}  // namespace simd
+
+struct Vec3 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+
+    Vec3 operator+(const Vec3& o) const { return {x + o.x, y + o.y, z + o.z}; }
+    Vec3 operator-(const Vec3& o) const { return {x - o.x, y - o.y, z - o.z}; }
+    Vec3 operator*(float s) const { return {x * s, y * s, z * s}; }
+};
+
+inline float dot(const Vec3& a, const Vec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline float length(const Vec3& v) {
+    return std::sqrt(dot(v, v));
+}
+
+inline Vec3 normalize(const Vec3& v) {
+    float len = length(v);
+    return len > 0.0f ? v * (1.0f / len) : v;
+}
+
+struct Vec4 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 0.0f;
+};
+
+// Unit quaternion rotation, x/y/z the vector part
+struct Quat {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f;
+
+    static Quat fromAxisAngle(const Vec3& axis, float radians) {
+        Vec3 n = normalize(axis);
+        float s = std::sin(radians * 0.5f);
+        return {n.x * s, n.y * s, n.z * s, std::cos(radians * 0.5f)};
+    }
+
+    // Applies o first, then this
+    Quat operator*(const Quat& o) const {
+        return {w * o.x + x * o.w + y * o.z - z * o.y,
+                w * o.y - x * o.z + y * o.w + z * o.x,
+                w * o.z + x * o.y - y * o.x + z * o.w,
+                w * o.w - x * o.x - y * o.y - z * o.z};
+    }
+
+    [[nodiscard]]
+    Vec3 rotate(const Vec3& v) const {
+        Vec3 u{x, y, z};
+        Vec3 t = cross(u, v) * 2.0f;
+        return v + t * w + cross(u, t);
+    }
+};
+
+inline Quat normalize(const Quat& q) {
+    float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    return {q.x * inv, q.y * inv, q.z * inv, q.w * inv};
+}
+
+// Column-major 4x4 matrix, the layout GL and InstanceData::transform expect
+struct alignas(16) Mat4 {
+    float m[16] = {};
+
+    static Mat4 identity() {
+        Mat4 r;
+        r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+        return r;
+    }
+
+    static Mat4 translation(const Vec3& t) {
+        Mat4 r = identity();
+        r.m[12] = t.x;
+        r.m[13] = t.y;
+        r.m[14] = t.z;
+        return r;
+    }
+
+    // Translation * rotation * uniform scale
+    static Mat4 compose(const Vec3& t, const Quat& q, float scale) {
+        float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+        Mat4 r;
+        r.m[0] = (1.0f - 2.0f * (yy + zz)) * scale;
+        r.m[1] = 2.0f * (xy + wz) * scale;
+        r.m[2] = 2.0f * (xz - wy) * scale;
+        r.m[4] = 2.0f * (xy - wz) * scale;
+        r.m[5] = (1.0f - 2.0f * (xx + zz)) * scale;
+        r.m[6] = 2.0f * (yz + wx) * scale;
+        r.m[8] = 2.0f * (xz + wy) * scale;
+        r.m[9] = 2.0f * (yz - wx) * scale;
+        r.m[10] = (1.0f - 2.0f * (xx + yy)) * scale;
+        r.m[12] = t.x;
+        r.m[13] = t.y;
+        r.m[14] = t.z;
+        r.m[15] = 1.0f;
+        return r;
+    }
+
+    // GL clip space, depth mapped to [-1, 1]
+    static Mat4 perspective(float fovYRadians, float aspect, float nearZ, float farZ) {
+        float f = 1.0f / std::tan(fovYRadians * 0.5f);
+        Mat4 r;
+        r.m[0] = f / aspect;
+        r.m[5] = f;
+        r.m[10] = (farZ + nearZ) / (nearZ - farZ);
+        r.m[11] = -1.0f;
+        r.m[14] = 2.0f * farZ * nearZ / (nearZ - farZ);
+        return r;
+    }
+
+    static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+        Vec3 f = normalize(target - eye);
+        Vec3 s = normalize(cross(f, up));
+        Vec3 u = cross(s, f);
+        Mat4 r = identity();
+        r.m[0] = s.x;
+        r.m[4] = s.y;
+        r.m[8] = s.z;
+        r.m[1] = u.x;
+        r.m[5] = u.y;
+        r.m[9] = u.z;
+        r.m[2] = -f.x;
+        r.m[6] = -f.y;
+        r.m[10] = -f.z;
+        r.m[12] = -dot(s, eye);
+        r.m[13] = -dot(u, eye);
+        r.m[14] = dot(f, eye);
+        return r;
+    }
+
+    Mat4 operator*(const Mat4& o) const {
+        simd::float4 c0 = simd::load(m);
+        simd::float4 c1 = simd::load(m + 4);
+        simd::float4 c2 = simd::load(m + 8);
+        simd::float4 c3 = simd::load(m + 12);
+        Mat4 r;
+        for (int j = 0; j < 4; ++j) {
+            const float* b = o.m + j * 4;
+            simd::float4 column = simd::mul(c0, simd::splat(b[0]));
+            column = simd::madd(c1, simd::splat(b[1]), column);
+            column = simd::madd(c2, simd::splat(b[2]), column);
+            column = simd::madd(c3, simd::splat(b[3]), column);
+            simd::store(r.m + j * 4, column);
+        }
+        return r;
+    }
+
+    [[nodiscard]]
+    Vec3 transformPoint(const Vec3& p) const {
+        return {m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]};
+    }
+};
+
+// Positions, rotations and uniform scales of many objects, one array per component
+struct TransformSoA {
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> scale;
+
+    void push(const Vec3& position, const Quat& rotation, float uniformScale) {
+        px.push_back(position.x);
+        py.push_back(position.y);
+        pz.push_back(position.z);
+        qx.push_back(rotation.x);
+        qy.push_back(rotation.y);
+        qz.push_back(rotation.z);
+        qw.push_back(rotation.w);
+        scale.push_back(uniformScale);
+    }
+
+    [[nodiscard]]
+    size_t size() const {
+        return px.size();
+    }
+};
+
+// Writes the matrix of each object in [begin, end) to out, one column-major float[16]
+// every stride floats, e.g. straight into an InstanceData array. The scalar version is
+// kept for the remainder and for comparing against.
+inline void composeTransformsScalar(const TransformSoA& t, uint32_t begin, uint32_t end, float* out,
+                                    size_t stride) {
+    for (uint32_t i = begin; i < end; ++i) {
+        Mat4 matrix = Mat4::compose({t.px[i], t.py[i], t.pz[i]}, {t.qx[i], t.qy[i], t.qz[i], t.qw[i]}, t.scale[i]);
+        float* target = out + (i - begin) * stride;
+        for (int e = 0; e < 16; ++e) {
+            target[e] = matrix.m[e];
+        }
+    }
+}
+
+// Matrices of the objects listed in indices, written to out in list order, e.g. only the
+// ones that survived culling
+inline void composeIndexedTransformsScalar(const TransformSoA& t, const uint32_t* indices, uint32_t count,
+                                           float* out, size_t stride) {
+    for (uint32_t k = 0; k < count; ++k) {
+        uint32_t i = indices[k];
+        Mat4 matrix = Mat4::compose({t.px[i], t.py[i], t.pz[i]}, {t.qx[i], t.qy[i], t.qz[i], t.qw[i]}, t.scale[i]);
+        float* target = out + k * stride;
+        for (int e = 0; e < 16; ++e) {
+            target[e] = matrix.m[e];
+        }
+    }
+}
+
+namespace simd {
+// Four matrices from four objects' components, one object per lane
+inline void composeTransforms4(float4 x, float4 y, float4 z, float4 w, float4 s, float4 px, float4 py,
+                               float4 pz, float* out, size_t stride) {
+    const float4 one = splat(1.0f);
+    const float4 two = splat(2.0f);
+    const float4 zero = splat(0.0f);
+    float4 s2 = mul(s, two);
+
+    float4 xx = mul(x, x), yy = mul(y, y), zz = mul(z, z);
+    float4 xy = mul(x, y), xz = mul(x, z), yz = mul(y, z);
+    float4 wx = mul(w, x), wy = mul(w, y), wz = mul(w, z);
+
+    // Element name is row then column
+    float4 m00 = mul(sub(one, mul(two, add(yy, zz))), s);
+    float4 m10 = mul(add(xy, wz), s2);
+    float4 m20 = mul(sub(xz, wy), s2);
+    float4 m01 = mul(sub(xy, wz), s2);
+    float4 m11 = mul(sub(one, mul(two, add(xx, zz))), s);
+    float4 m21 = mul(add(yz, wx), s2);
+    float4 m02 = mul(add(xz, wy), s2);
+    float4 m12 = mul(sub(yz, wx), s2);
+    float4 m22 = mul(sub(one, mul(two, add(xx, yy))), s);
+    float4 m03 = px, m13 = py, m23 = pz;
+
+    float4 c0r3 = zero, c1r3 = zero, c2r3 = zero, c3r3 = one;
+    transpose(m00, m10, m20, c0r3);
+    transpose(m01, m11, m21, c1r3);
+    transpose(m02, m12, m22, c2r3);
+    transpose(m03, m13, m23, c3r3);
+
+    // After the transposes register n of each group is column c of object n
+    float4* columns[4][4] = {
+        {&m00, &m01, &m02, &m03},
+        {&m10, &m11, &m12, &m13},
+        {&m20, &m21, &m22, &m23},
+        {&c0r3, &c1r3, &c2r3, &c3r3},
+    };
+    for (uint32_t object = 0; object < 4; ++object) {
+        float* target = out + object * stride;
+        for (int column = 0; column < 4; ++column) {
+            store(target + column * 4, *columns[object][column]);
+        }
+    }
+}
+}  // namespace simd
+
+// Same as composeTransformsScalar, four objects per iteration: every matrix element is
+// computed for four objects in one register, then 4x4 transposes turn those into columns
+inline void composeTransforms(const TransformSoA& t, uint32_t begin, uint32_t end, float* out, size_t stride) {
+    using namespace simd;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        composeTransforms4(load(&t.qx[i]), load(&t.qy[i]), load(&t.qz[i]), load(&t.qw[i]), load(&t.scale[i]),
+                           load(&t.px[i]), load(&t.py[i]), load(&t.pz[i]), out + (i - begin) * stride, stride);
+    }
+    composeTransformsScalar(t, i, end, out + (i - begin) * stride, stride);
+}
+
+// The listed objects, gathered four at a time into registers
+inline void composeIndexedTransforms(const TransformSoA& t, const uint32_t* indices, uint32_t count, float* out,
+                                     size_t stride) {
+    using namespace simd;
+    uint32_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const uint32_t* lane = indices + k;
+        auto gather = [lane](const std::vector<float>& values) {
+            alignas(16) float packed[4] = {values[lane[0]], values[lane[1]], values[lane[2]], values[lane[3]]};
+            return load(packed);
+        };
+        composeTransforms4(gather(t.qx), gather(t.qy), gather(t.qz), gather(t.qw), gather(t.scale),
+                           gather(t.px), gather(t.py), gather(t.pz), out + k * stride, stride);
+    }
+    composeIndexedTransformsScalar(t, indices + k, count - k, out + k * stride, stride);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free ring buffer for one producer thread and one consumer thread.
+// push() returns false when full and pop() returns false when empty; neither blocks.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    static constexpr size_t kMask = Capacity - 1;
+
+    T mItems[Capacity] = {};
+    // Head and tail live on separate cache lines so the two threads don't false-share
+    alignas(64) std::atomic<size_t> mHead{0};  // Next slot to read, written by the consumer
+    alignas(64) std::atomic<size_t> mTail{0};  // Next slot to write, written by the producer
+
+public:
+    bool push(const T& item) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        mItems[tail & kMask] = item;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = mItems[head & kMask];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
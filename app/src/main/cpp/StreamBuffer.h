@@ -0,0 +1,180 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "Log.h"
+
+// Ring-buffered storage for data rewritten every frame.
+// One GL buffer is split into kSegmentCount segments and each frame writes only into
+// its own segment, guarded by a fence placed when the frame was submitted. With three
+// segments the fence of the segment being reused has almost always signalled, so the
+// CPU writes next-frame data without waiting on the GPU. Writes go through a
+// persistent coherent mapping when GL_EXT_buffer_storage is present and through
+// unsynchronized glMapBufferRange otherwise.
+class StreamBuffer {
+public:
+    struct Allocation {
+        void* data;
+        GLintptr offset;  // Byte offset into buffer() for binding
+        GLsizeiptr size;
+    };
+
+private:
+    static constexpr size_t kSegmentCount = 3;
+    static constexpr GLuint64 kFenceTimeoutNs = 100000000;
+
+    GLenum mTarget = GL_ARRAY_BUFFER;
+    GLuint mBuffer = 0;
+    GLsizeiptr mSegmentSize = 0;
+    size_t mSegment = 0;
+    GLsizeiptr mSegmentOffset = 0;
+    GLsync mFences[kSegmentCount] = {};
+    uint8_t* mPersistentData = nullptr;
+
+    void waitForSegment(size_t segment) {
+        GLsync fence = mFences[segment];
+        if (!fence) {
+            return;
+        }
+
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            LOG_INFO("Stream buffer waiting on the GPU, consider more segments");
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        mFences[segment] = nullptr;
+    }
+
+public:
+    StreamBuffer() = default;
+    ~StreamBuffer() {
+        cleanup();
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Must be called with a current context; segmentSize is the most one frame can write
+    bool initialize(GLenum target, GLsizeiptr segmentSize) {
+        mTarget = target;
+        mSegmentSize = segmentSize;
+        GLsizeiptr totalSize = segmentSize * static_cast<GLsizeiptr>(kSegmentCount);
+
+        GLStateCache& state = GLStateCache::current();
+        glGenBuffers(1, &mBuffer);
+        state.bindBuffer(mTarget, mBuffer);
+
+        auto bufferStorage = hasGLExtension("GL_EXT_buffer_storage")
+                ? reinterpret_cast<PFNGLBUFFERSTORAGEEXTPROC>(eglGetProcAddress("glBufferStorageEXT"))
+                : nullptr;
+        if (bufferStorage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+            bufferStorage(mTarget, totalSize, nullptr, flags);
+            mPersistentData = static_cast<uint8_t*>(glMapBufferRange(mTarget, 0, totalSize, flags));
+        }
+
+        if (!mPersistentData) {
+            // Either no buffer_storage or the persistent map failed; immutable storage can't be respecified
+            if (bufferStorage) {
+                state.onBufferDeleted(mBuffer);
+                glDeleteBuffers(1, &mBuffer);
+                glGenBuffers(1, &mBuffer);
+                state.bindBuffer(mTarget, mBuffer);
+            }
+            glBufferData(mTarget, totalSize, nullptr, GL_STREAM_DRAW);
+        }
+
+        return mBuffer != 0;
+    }
+
+    // Moves to the next segment, waiting only if the GPU is still reading it
+    void beginFrame() {
+        mSegment = (mSegment + 1) % kSegmentCount;
+        mSegmentOffset = 0;
+        waitForSegment(mSegment);
+    }
+
+    // Returns nullptr data when the frame's segment is full
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+        GLsizeiptr offset = (mSegmentOffset + alignment - 1) / alignment * alignment;
+        if (offset + size > mSegmentSize) {
+            return {nullptr, 0, 0};
+        }
+        mSegmentOffset = offset + size;
+
+        GLintptr bufferOffset = static_cast<GLintptr>(mSegment) * mSegmentSize + offset;
+        if (mPersistentData) {
+            return {mPersistentData + bufferOffset, bufferOffset, size};
+        }
+
+        // The fence already guarantees the GPU is done with this range
+        GLStateCache::current().bindBuffer(mTarget, mBuffer);
+        void* data = glMapBufferRange(mTarget, bufferOffset, size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        return {data, bufferOffset, size};
+    }
+
+    // Finishes the writes to an allocation before it is drawn from
+    void commit(const Allocation& allocation) {
+        if (!mPersistentData && allocation.data) {
+            GLStateCache::current().bindBuffer(mTarget, mBuffer);
+            glUnmapBuffer(mTarget);
+        }
+    }
+
+    // Fences everything drawn from this frame's segment
+    void endFrame() {
+        if (mFences[mSegment]) {
+            glDeleteSync(mFences[mSegment]);
+        }
+        mFences[mSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    [[nodiscard]]
+    GLuint buffer() const {
+        return mBuffer;
+    }
+
+    [[nodiscard]]
+    bool isPersistent() const {
+        return mPersistentData != nullptr;
+    }
+
+    void cleanup() {
+        for (GLsync& fence : mFences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (mBuffer) {
+            GLStateCache& state = GLStateCache::current();
+            if (mPersistentData) {
+                state.bindBuffer(mTarget, mBuffer);
+                glUnmapBuffer(mTarget);
+                mPersistentData = nullptr;
+            }
+            state.onBufferDeleted(mBuffer);
+            glDeleteBuffers(1, &mBuffer);
+            mBuffer = 0;
+        }
+    }
+
+    // Forget the buffer and fences without deleting them, for when their context is already gone
+    void invalidate() {
+        std::fill(std::begin(mFences), std::end(mFences), nullptr);
+        mPersistentData = nullptr;
+        mBuffer = 0;
+    }
+};
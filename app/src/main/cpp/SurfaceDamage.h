@@ -0,0 +1,177 @@
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "Log.h"
+
+// Window pixels, origin at the bottom left like GL and EGL
+struct DamageRect {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+
+    [[nodiscard]]
+    bool isEmpty() const {
+        return width <= 0 || height <= 0;
+    }
+
+    // The bounding box of both; a single rectangle keeps it usable as a scissor
+    void unite(const DamageRect& other) {
+        if (other.isEmpty()) {
+            return;
+        }
+        if (isEmpty()) {
+            *this = other;
+            return;
+        }
+        int32_t right = std::max(x + width, other.x + other.width);
+        int32_t top = std::max(y + height, other.y + other.height);
+        x = std::min(x, other.x);
+        y = std::min(y, other.y);
+        width = right - x;
+        height = top - y;
+    }
+
+    void clip(int32_t surfaceWidth, int32_t surfaceHeight) {
+        int32_t right = std::min(x + width, surfaceWidth);
+        int32_t top = std::min(y + height, surfaceHeight);
+        x = std::max(x, 0);
+        y = std::max(y, 0);
+        width = std::max(right - x, 0);
+        height = std::max(top - y, 0);
+    }
+};
+
+// Partial repaints of the window surface.
+// Each frame says which pixels it changes. With EGL_EXT_buffer_age (or the age query in
+// EGL_KHR_partial_update) the back buffer still holds a frame from a few swaps ago, so
+// only this frame's damage plus that of the frames the buffer missed has to be redrawn.
+// EGL_KHR_partial_update tells the driver so it can skip loading the rest, and
+// swap_buffers_with_damage tells the compositor. Without an age everything is repainted.
+class SurfaceDamage {
+private:
+    // Buffers older than this are repainted in full; swapchains are rarely deeper
+    static constexpr size_t kHistorySize = 4;
+
+    PFNEGLSETDAMAGEREGIONKHRPROC mSetDamageRegion = nullptr;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC mSwapWithDamage = nullptr;
+    bool mHasBufferAge = false;
+    int32_t mWidth = 0;
+    int32_t mHeight = 0;
+    // Damage of previous frames, newest at mHistoryIndex - 1
+    DamageRect mHistory[kHistorySize];
+    size_t mHistoryIndex = 0;
+    size_t mHistoryCount = 0;
+    DamageRect mFrameDamage;
+
+    static bool hasEGLExtension(const char* extensions, const char* name) {
+        size_t length = strlen(name);
+        for (const char* found = strstr(extensions, name); found; found = strstr(found + length, name)) {
+            char next = found[length];
+            if ((found == extensions || found[-1] == ' ') && (next == ' ' || next == '\0')) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]]
+    DamageRect fullSurface() const {
+        return {0, 0, mWidth, mHeight};
+    }
+
+public:
+    SurfaceDamage() = default;
+
+    SurfaceDamage(const SurfaceDamage&) = delete;
+    SurfaceDamage& operator=(const SurfaceDamage&) = delete;
+
+    // Configure a freshly created surface; nothing is known about its buffers yet
+    void attachSurface(EGLDisplay display) {
+        const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+        extensions = extensions ? extensions : "";
+        bool partialUpdate = hasEGLExtension(extensions, "EGL_KHR_partial_update");
+        mHasBufferAge = partialUpdate || hasEGLExtension(extensions, "EGL_EXT_buffer_age");
+        mSetDamageRegion = partialUpdate
+                ? reinterpret_cast<PFNEGLSETDAMAGEREGIONKHRPROC>(eglGetProcAddress("eglSetDamageRegionKHR"))
+                : nullptr;
+
+        // Both flavours take the same arguments
+        mSwapWithDamage = nullptr;
+        if (hasEGLExtension(extensions, "EGL_KHR_swap_buffers_with_damage")) {
+            mSwapWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+        } else if (hasEGLExtension(extensions, "EGL_EXT_swap_buffers_with_damage")) {
+            mSwapWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                    eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+        }
+        mHistoryCount = 0;
+        LOG_INFO("Partial repaints: buffer age %s, partial update %s, swap with damage %s",
+                 mHasBufferAge ? "yes" : "no", mSetDamageRegion ? "yes" : "no", mSwapWithDamage ? "yes" : "no");
+    }
+
+    // Old buffers have the wrong size, so everything is repainted after a resize
+    void resize(int32_t width, int32_t height) {
+        mWidth = width;
+        mHeight = height;
+        mHistoryCount = 0;
+    }
+
+    void addDamage(DamageRect rect) {
+        rect.clip(mWidth, mHeight);
+        mFrameDamage.unite(rect);
+    }
+
+    void damageAll() {
+        mFrameDamage = fullSurface();
+    }
+
+    // Call once all of the frame's damage is known and before anything is drawn to the
+    // surface; the result is what has to be redrawn, so use it as the scissor.
+    // A frame that reports no damage is taken to be untracked and repaints everything.
+    DamageRect beginFrame(EGLDisplay display, EGLSurface surface) {
+        if (mFrameDamage.isEmpty()) {
+            mFrameDamage = fullSurface();
+        }
+
+        EGLint age = 0;
+        if (mHasBufferAge) {
+            eglQuerySurface(display, surface, EGL_BUFFER_AGE_EXT, &age);
+        }
+        DamageRect repaint = mFrameDamage;
+        if (age <= 0 || static_cast<size_t>(age) > mHistoryCount + 1) {
+            repaint = fullSurface();
+        } else {
+            // An age of 1 is last frame's buffer, which only misses this frame's damage
+            for (EGLint i = 1; i < age; ++i) {
+                repaint.unite(mHistory[(mHistoryIndex + kHistorySize - i) % kHistorySize]);
+            }
+        }
+
+        if (mSetDamageRegion) {
+            EGLint rect[4] = {repaint.x, repaint.y, repaint.width, repaint.height};
+            mSetDamageRegion(display, surface, rect, 1);
+        }
+        return repaint;
+    }
+
+    // Replaces eglSwapBuffers for frames started with beginFrame()
+    EGLBoolean swapBuffers(EGLDisplay display, EGLSurface surface) {
+        DamageRect damage = mFrameDamage;
+        mHistory[mHistoryIndex] = damage;
+        mHistoryIndex = (mHistoryIndex + 1) % kHistorySize;
+        mHistoryCount = std::min(mHistoryCount + 1, kHistorySize);
+        mFrameDamage = {};
+
+        if (mSwapWithDamage) {
+            EGLint rect[4] = {damage.x, damage.y, damage.width, damage.height};
+            return mSwapWithDamage(display, surface, rect, 1);
+        }
+        return eglSwapBuffers(display, surface);
+    }
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <android/asset_manager.h>
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <string>
+
+#include "AssetLoader.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "Ktx2File.h"
+#include "Log.h"
+
+// An immutable 2D texture in a compressed format. glTexStorage2D allocates every level
+// up front, the levels are then filled in any order, and GL_TEXTURE_BASE_LEVEL keeps
+// sampling to the levels that actually hold data.
+class Texture {
+private:
+    GLuint mTexture = 0;
+    GLenum mFormat = 0;
+    GLsizei mLevelCount = 0;
+    GLint mBaseLevel = 0;
+
+public:
+    Texture() = default;
+    ~Texture() {
+        cleanup();
+    }
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    // ETC2 is core in GLES 3.0, ASTC is cheaper for the same quality where it exists
+    static bool supportsAstc() {
+        return hasGLExtension("GL_KHR_texture_compression_astc_ldr");
+    }
+
+    // May run on the asset loader's shared context; nothing is sampled until setBaseLevel()
+    bool initialize(GLenum format, GLsizei width, GLsizei height, GLsizei levelCount) {
+        glGenTextures(1, &mTexture);
+        GLStateCache::current().bindTexture(0, GL_TEXTURE_2D, mTexture);
+        glTexStorage2D(GL_TEXTURE_2D, levelCount, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+        mFormat = format;
+        mLevelCount = levelCount;
+        mBaseLevel = levelCount - 1;
+        if (glGetError() != GL_NO_ERROR) {
+            LOG_ERROR("Failed to allocate a %dx%d texture in format 0x%x", width, height, format);
+            cleanup();
+            return false;
+        }
+        return true;
+    }
+
+    // May run on the asset loader's shared context
+    bool uploadLevel(GLint level, const Ktx2File::Level& data) {
+        GLStateCache::current().bindTexture(0, GL_TEXTURE_2D, mTexture);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, data.width, data.height, mFormat, data.size,
+                                  data.data);
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    // Render thread, once the levels from here down have finished uploading
+    void setBaseLevel(GLint level) {
+        GLStateCache::current().rebindTexture(0, GL_TEXTURE_2D, mTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        mBaseLevel = level;
+    }
+
+    void bind(GLuint unit) const {
+        GLStateCache::current().bindTexture(unit, GL_TEXTURE_2D, mTexture);
+    }
+
+    [[nodiscard]]
+    bool isReady() const {
+        return mTexture != 0;
+    }
+
+    [[nodiscard]]
+    GLsizei levelCount() const {
+        return mLevelCount;
+    }
+
+    // Finest level sampling can reach
+    [[nodiscard]]
+    GLint baseLevel() const {
+        return mBaseLevel;
+    }
+
+    void cleanup() {
+        if (mTexture) {
+            GLStateCache::current().onTextureDeleted(mTexture);
+            glDeleteTextures(1, &mTexture);
+            mTexture = 0;
+        }
+        mLevelCount = 0;
+        mBaseLevel = 0;
+    }
+
+    // The context owning the texture is already gone, so only forget the name
+    void invalidate() {
+        mTexture = 0;
+        mLevelCount = 0;
+        mBaseLevel = 0;
+    }
+};
+
+// A KTX2 texture that loads its small levels first and streams finer ones on demand.
+// Each texture ships as <name>.astc.ktx2 and/or <name>.etc2.ktx2 and open() maps the
+// one this GPU samples. Levels are uploaded by the AssetLoader one per request, straight
+// from the mapped asset, and the base level only drops once the GPU has the new level.
+class StreamedTexture {
+public:
+    static constexpr GLsizei kStartupSize = 64;  // Levels up to this size load with the texture
+
+private:
+    Ktx2File mFile;
+    Texture mTexture;
+    GLint mStartupLevel = 0;
+    GLint mRequestedLevel = 0;
+    GLint mLoadingLevel = -1;  // Finest level of the request in flight, -1 when idle
+    bool mResident = false;    // Render thread; the loader creates mTexture before this is set
+    bool mFailed = false;
+
+    static bool uploadStartup(void* context) {
+        auto* texture = static_cast<StreamedTexture*>(context);
+        const Ktx2File& file = texture->mFile;
+        if (!texture->mTexture.initialize(file.format(), file.width(), file.height(), file.levelCount())) {
+            return false;
+        }
+        for (GLint level = file.levelCount() - 1; level >= texture->mLoadingLevel; --level) {
+            if (!texture->mTexture.uploadLevel(level, file.level(level))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool uploadNextLevel(void* context) {
+        auto* texture = static_cast<StreamedTexture*>(context);
+        return texture->mTexture.uploadLevel(texture->mLoadingLevel, texture->mFile.level(texture->mLoadingLevel));
+    }
+
+    static void complete(void* context, bool ok) {
+        auto* texture = static_cast<StreamedTexture*>(context);
+        if (ok) {
+            texture->mTexture.setBaseLevel(texture->mLoadingLevel);
+            texture->mResident = true;
+        } else {
+            LOG_ERROR("Failed to upload texture level %d", texture->mLoadingLevel);
+            texture->mFailed = true;
+        }
+        texture->mLoadingLevel = -1;
+    }
+
+    void submit(AssetLoader& loader, GLint level, bool (*upload)(void*)) {
+        mLoadingLevel = level;
+        const AssetLoader::Request request = {upload, &StreamedTexture::complete, this};
+        if (!loader.submit(request)) {
+            // No loader context, so take the hit on this thread instead
+            complete(this, upload(this));
+        }
+    }
+
+    [[nodiscard]]
+    GLsizei levelSize(GLint level) const {
+        const Ktx2File::Level& data = mFile.level(level);
+        return std::max(data.width, data.height);
+    }
+
+public:
+    StreamedTexture() = default;
+
+    StreamedTexture(const StreamedTexture&) = delete;
+    StreamedTexture& operator=(const StreamedTexture&) = delete;
+
+    // Needs a current context to pick the format; the asset stays mapped for streaming
+    bool open(AAssetManager* assetManager, const char* name) {
+        std::string astcPath = std::string(name) + ".astc.ktx2";
+        std::string etc2Path = std::string(name) + ".etc2.ktx2";
+        if (!(Texture::supportsAstc() && mFile.open(assetManager, astcPath.c_str())) &&
+            !mFile.open(assetManager, etc2Path.c_str())) {
+            return false;
+        }
+
+        mStartupLevel = mFile.levelCount() - 1;
+        while (mStartupLevel > 0 && levelSize(mStartupLevel - 1) <= kStartupSize) {
+            --mStartupLevel;
+        }
+        mRequestedLevel = mStartupLevel;
+        LOG_INFO("Loaded texture %s: %dx%d, %d levels, format 0x%x", name, mFile.width(), mFile.height(),
+                 mFile.levelCount(), mFile.format());
+        return true;
+    }
+
+    [[nodiscard]]
+    bool isOpen() const {
+        return mFile.isOpen();
+    }
+
+    // Render thread; uploads the startup levels, the texture is not sampled until they are in
+    void load(AssetLoader& loader) {
+        if (mFile.isOpen() && !mResident && mLoadingLevel < 0) {
+            mFailed = false;
+            submit(loader, mStartupLevel, &StreamedTexture::uploadStartup);
+        }
+    }
+
+    // Render thread; asks for the coarsest level that still covers the given on-screen size
+    void requestSize(GLsizei pixels) {
+        if (!mFile.isOpen()) {
+            return;
+        }
+        GLint level = mStartupLevel;
+        while (level > 0 && levelSize(level) < pixels) {
+            --level;
+        }
+        mRequestedLevel = level;
+    }
+
+    // Render thread, once per frame; streams in at most one finer level at a time
+    void update(AssetLoader& loader) {
+        if (!mResident || mFailed || mLoadingLevel >= 0 || mRequestedLevel >= mTexture.baseLevel()) {
+            return;
+        }
+        submit(loader, mTexture.baseLevel() - 1, &StreamedTexture::uploadNextLevel);
+    }
+
+    [[nodiscard]]
+    bool isReady() const {
+        return mResident;
+    }
+
+    // The startup levels never made it in, so the texture won't become ready
+    [[nodiscard]]
+    bool hasFailed() const {
+        return mFailed && !mResident;
+    }
+
+    [[nodiscard]]
+    const Texture& texture() const {
+        return mTexture;
+    }
+
+    // Render thread, with no upload in flight
+    void cleanup() {
+        mTexture.cleanup();
+        mResident = false;
+        mLoadingLevel = -1;
+    }
+
+    // The context is gone and the loader was stopped, dropping any request in flight
+    void invalidate() {
+        mTexture.invalidate();
+        mResident = false;
+        mLoadingLevel = -1;
+    }
+};
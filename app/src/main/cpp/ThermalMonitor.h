@@ -0,0 +1,144 @@
+#pragma once
+
+#include <dlfcn.h>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+#include "Log.h"
+
+// Device thermal state, reduced to how hard the app should back off.
+// The status listener (API 30) says when the OS has started throttling; the headroom
+// forecast (API 31) warns before it does, so the app can shed load on its own terms.
+// Both are resolved at runtime, and without them the pressure always stays None.
+class ThermalMonitor {
+public:
+    enum class Pressure {
+        None,
+        Warm,  // Approaching throttling: trim the resolution
+        Hot    // Throttling: halve the frame rate as well
+    };
+
+private:
+    using AcquireManagerFn = void* (*)();
+    using ReleaseManagerFn = void (*)(void*);
+    using StatusCallback = void (*)(void*, int32_t);
+    using ListenerFn = int (*)(void*, StatusCallback, void*);
+    using GetHeadroomFn = float (*)(void*, int);
+
+    // AThermalStatus values
+    static constexpr int32_t kStatusLight = 1;
+    static constexpr int32_t kStatusSevere = 3;
+    static constexpr int kForecastSeconds = 10;
+    // 1.0 is where the OS throttles
+    static constexpr float kWarmHeadroom = 0.85f;
+    static constexpr float kHotHeadroom = 1.0f;
+    // The headroom call is rate limited by the OS and results within a second are stale
+    static constexpr int64_t kHeadroomIntervalNs = 2000000000LL;
+    // Pressure only eases once it has stayed lower for this long, so the app doesn't flap
+    static constexpr int64_t kCooldownNs = 10000000000LL;
+
+    void* mManager = nullptr;
+    ReleaseManagerFn mReleaseManager = nullptr;
+    ListenerFn mUnregisterListener = nullptr;
+    GetHeadroomFn mGetHeadroom = nullptr;
+    bool mListening = false;
+    // Written by the binder thread the listener is called on
+    std::atomic<int32_t> mStatus{0};
+    float mHeadroom = 0.0f;
+    int64_t mLastHeadroomNs = 0;
+    Pressure mPressure = Pressure::None;
+    int64_t mLastPeakNs = 0;
+
+    static int64_t nowNanos() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    static void onStatusChanged(void* data, int32_t status) {
+        static_cast<ThermalMonitor*>(data)->mStatus.store(status, std::memory_order_relaxed);
+        LOG_INFO("Thermal status changed to %d", status);
+    }
+
+    [[nodiscard]]
+    Pressure currentPressure() const {
+        int32_t status = mStatus.load(std::memory_order_relaxed);
+        if (status >= kStatusSevere || mHeadroom >= kHotHeadroom) {
+            return Pressure::Hot;
+        }
+        if (status >= kStatusLight || mHeadroom >= kWarmHeadroom) {
+            return Pressure::Warm;
+        }
+        return Pressure::None;
+    }
+
+public:
+    ThermalMonitor() = default;
+    ~ThermalMonitor() {
+        cleanup();
+    }
+
+    ThermalMonitor(const ThermalMonitor&) = delete;
+    ThermalMonitor& operator=(const ThermalMonitor&) = delete;
+
+    bool initialize() {
+        void* lib = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (!lib) {
+            return false;
+        }
+        auto acquireManager = reinterpret_cast<AcquireManagerFn>(dlsym(lib, "AThermal_acquireManager"));
+        mReleaseManager = reinterpret_cast<ReleaseManagerFn>(dlsym(lib, "AThermal_releaseManager"));
+        auto registerListener = reinterpret_cast<ListenerFn>(dlsym(lib, "AThermal_registerThermalStatusListener"));
+        mUnregisterListener = reinterpret_cast<ListenerFn>(dlsym(lib, "AThermal_unregisterThermalStatusListener"));
+        mGetHeadroom = reinterpret_cast<GetHeadroomFn>(dlsym(lib, "AThermal_getThermalHeadroom"));
+
+        mManager = acquireManager && mReleaseManager && registerListener && mUnregisterListener
+                ? acquireManager() : nullptr;
+        if (!mManager) {
+            mGetHeadroom = nullptr;
+            LOG_INFO("Thermal status not available");
+            return false;
+        }
+        // The listener is called once straight away with the current status
+        mListening = registerListener(mManager, onStatusChanged, this) == 0;
+        LOG_INFO("Thermal monitoring with%s headroom forecasts", mGetHeadroom ? "" : "out");
+        return true;
+    }
+
+    // Call once per frame on the thread that acts on the result
+    Pressure poll() {
+        if (!mManager) {
+            return Pressure::None;
+        }
+        int64_t now = nowNanos();
+        if (mGetHeadroom && now - mLastHeadroomNs >= kHeadroomIntervalNs) {
+            float headroom = mGetHeadroom(mManager, kForecastSeconds);
+            // NaN when the OS has no forecast yet
+            mHeadroom = std::isnan(headroom) ? 0.0f : headroom;
+            mLastHeadroomNs = now;
+        }
+
+        Pressure pressure = currentPressure();
+        if (pressure >= mPressure) {
+            mPressure = pressure;
+            mLastPeakNs = now;
+        } else if (now - mLastPeakNs >= kCooldownNs) {
+            mPressure = pressure;
+        }
+        return mPressure;
+    }
+
+    void cleanup() {
+        if (!mManager) {
+            return;
+        }
+        if (mListening) {
+            mUnregisterListener(mManager, onStatusChanged, this);
+            mListening = false;
+        }
+        mReleaseManager(mManager);
+        mManager = nullptr;
+    }
+};
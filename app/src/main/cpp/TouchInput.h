@@ -0,0 +1,244 @@
+#pragma once
+
+#include <android/input.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Log.h"
+#include "SpscQueue.h"
+
+// Touch input handed from the main thread to the render thread.
+// The glue calls onInputEvent on the main thread for every event in the AInputQueue, and
+// each motion event is unpacked into its batched historical samples plus the current one
+// and pushed into a lock-free ring. The render thread drains the ring whenever it wants
+// the newest input, so a sample never waits for the next pass of the main loop, and can
+// extrapolate the pointer to when the frame will be shown. Only the first pointer down
+// is followed, as a drag.
+class TouchInput {
+private:
+    struct Sample {
+        enum class Type : uint8_t {
+            Down,
+            Move,
+            Up
+        };
+
+        int64_t timeNs;
+        float x;  // Window pixels from the top left
+        float y;
+        Type type;
+    };
+
+    static constexpr size_t kCapacity = 512;
+    // Further than this overshoots whenever the finger stops or turns
+    static constexpr int64_t kMaxPredictionNs = 20000000;
+    // Samples further apart than this don't give a usable velocity
+    static constexpr int64_t kVelocityWindowNs = 50000000;
+    static constexpr float kVelocitySmoothing = 0.5f;
+
+    SpscQueue<Sample, kCapacity> mSamples;
+    std::atomic<uint32_t> mDropped{0};
+
+    // Main thread
+    int32_t mPointerId = -1;
+
+    // Render thread; velocities are in pixels per second
+    bool mPrediction = false;
+    bool mTouching = false;
+    float mStartX = 0.0f;
+    float mStartY = 0.0f;
+    float mX = 0.0f;
+    float mY = 0.0f;
+    float mVelocityX = 0.0f;
+    float mVelocityY = 0.0f;
+    int64_t mTimeNs = 0;
+    // Drag distance of every finished gesture
+    float mCommittedX = 0.0f;
+    float mCommittedY = 0.0f;
+
+    void push(Sample::Type type, int64_t timeNs, float x, float y) {
+        if (!mSamples.push({timeNs, x, y, type})) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Current and historical samples of one pointer, oldest first
+    void pushMoves(const AInputEvent* event, size_t pointerIndex) {
+        size_t history = AMotionEvent_getHistorySize(event);
+        for (size_t i = 0; i < history; ++i) {
+            push(Sample::Type::Move, AMotionEvent_getHistoricalEventTime(event, i),
+                 AMotionEvent_getHistoricalX(event, pointerIndex, i),
+                 AMotionEvent_getHistoricalY(event, pointerIndex, i));
+        }
+        push(Sample::Type::Move, AMotionEvent_getEventTime(event),
+             AMotionEvent_getX(event, pointerIndex), AMotionEvent_getY(event, pointerIndex));
+    }
+
+    bool findPointer(const AInputEvent* event, size_t& index) const {
+        size_t count = AMotionEvent_getPointerCount(event);
+        for (size_t i = 0; i < count; ++i) {
+            if (AMotionEvent_getPointerId(event, i) == mPointerId) {
+                index = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void apply(const Sample& sample) {
+        switch (sample.type) {
+            case Sample::Type::Down: {
+                mTouching = true;
+                mStartX = sample.x;
+                mStartY = sample.y;
+                mVelocityX = 0.0f;
+                mVelocityY = 0.0f;
+                break;
+            }
+
+            case Sample::Type::Move: {
+                int64_t elapsedNs = sample.timeNs - mTimeNs;
+                if (elapsedNs > 0 && elapsedNs < kVelocityWindowNs) {
+                    float seconds = static_cast<float>(elapsedNs) / 1e9f;
+                    mVelocityX += kVelocitySmoothing * ((sample.x - mX) / seconds - mVelocityX);
+                    mVelocityY += kVelocitySmoothing * ((sample.y - mY) / seconds - mVelocityY);
+                } else if (elapsedNs >= kVelocityWindowNs) {
+                    mVelocityX = 0.0f;
+                    mVelocityY = 0.0f;
+                }
+                break;
+            }
+
+            case Sample::Type::Up: {
+                if (mTouching) {
+                    mCommittedX += sample.x - mStartX;
+                    mCommittedY += sample.y - mStartY;
+                }
+                mTouching = false;
+                mVelocityX = 0.0f;
+                mVelocityY = 0.0f;
+                break;
+            }
+        }
+        mX = sample.x;
+        mY = sample.y;
+        mTimeNs = sample.timeNs;
+    }
+
+public:
+    TouchInput() = default;
+
+    TouchInput(const TouchInput&) = delete;
+    TouchInput& operator=(const TouchInput&) = delete;
+
+    // Render thread, or before it starts
+    void setPrediction(bool enabled) {
+        mPrediction = enabled;
+    }
+
+    // Main thread; returns 1 when the event was consumed, as onInputEvent expects
+    int32_t handleEvent(const AInputEvent* event) {
+        if (AInputEvent_getType(event) != AINPUT_EVENT_TYPE_MOTION ||
+            !(AInputEvent_getSource(event) & AINPUT_SOURCE_CLASS_POINTER)) {
+            return 0;
+        }
+
+        int32_t action = AMotionEvent_getAction(event);
+        auto actionIndex = static_cast<size_t>((action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >>
+                                               AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+        size_t index = 0;
+        switch (action & AMOTION_EVENT_ACTION_MASK) {
+            case AMOTION_EVENT_ACTION_DOWN: {
+                mPointerId = AMotionEvent_getPointerId(event, 0);
+                push(Sample::Type::Down, AMotionEvent_getEventTime(event),
+                     AMotionEvent_getX(event, 0), AMotionEvent_getY(event, 0));
+                break;
+            }
+
+            case AMOTION_EVENT_ACTION_MOVE: {
+                if (findPointer(event, index)) {
+                    pushMoves(event, index);
+                }
+                break;
+            }
+
+            case AMOTION_EVENT_ACTION_POINTER_UP: {
+                if (AMotionEvent_getPointerId(event, actionIndex) != mPointerId) {
+                    break;
+                }
+                // The gesture ends with the followed pointer even while others stay down
+                [[fallthrough]];
+            }
+
+            case AMOTION_EVENT_ACTION_UP:
+            case AMOTION_EVENT_ACTION_CANCEL: {
+                if (findPointer(event, index)) {
+                    push(Sample::Type::Up, AMotionEvent_getEventTime(event),
+                         AMotionEvent_getX(event, index), AMotionEvent_getY(event, index));
+                }
+                mPointerId = -1;
+                break;
+            }
+
+            default:
+                break;
+        }
+        return 1;
+    }
+
+    // Render thread; applies every sample queued since the last call and returns whether there were any
+    bool update() {
+        bool changed = false;
+        Sample sample{};
+        while (mSamples.pop(sample)) {
+            apply(sample);
+            changed = true;
+        }
+        uint32_t dropped = mDropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            LOG_ERROR("Touch input ring full, dropped %u samples", dropped);
+        }
+        return changed;
+    }
+
+    [[nodiscard]]
+    bool isTouching() const {
+        return mTouching;
+    }
+
+    // Event time of the newest sample applied
+    [[nodiscard]]
+    int64_t latestTimeNs() const {
+        return mTimeNs;
+    }
+
+    // Render thread; how far every drag so far has moved, in window pixels. The gesture in
+    // progress is extrapolated to targetNs, the expected display time, if prediction is on.
+    void dragOffset(int64_t targetNs, float& dx, float& dy) const {
+        dx = mCommittedX;
+        dy = mCommittedY;
+        if (!mTouching) {
+            return;
+        }
+        float x = mX;
+        float y = mY;
+        if (mPrediction) {
+            float ahead = static_cast<float>(std::clamp<int64_t>(targetNs - mTimeNs, 0, kMaxPredictionNs)) / 1e9f;
+            x += mVelocityX * ahead;
+            y += mVelocityY * ahead;
+        }
+        dx += x - mStartX;
+        dy += y - mStartY;
+    }
+
+    // dragOffset() as a clip space translation for a window of this size, y pointing up
+    void panOffset(int64_t targetNs, float width, float height, float& panX, float& panY) const {
+        float dx = 0.0f;
+        float dy = 0.0f;
+        dragOffset(targetNs, dx, dy);
+        panX = width > 0.0f ? 2.0f * dx / width : 0.0f;
+        panY = height > 0.0f ? -2.0f * dy / height : 0.0f;
+    }
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <GLES3/gl31.h>
+#include <cstddef>
+
+#include "GLStateCache.h"
+#include "VertexLayout.h"
+
+// Per-instance attributes for instanced drawing
+struct InstanceData {
+    float transform[16];  // Column-major model matrix
+    float color[4];
+};
+
+// Triangle mesh class
+class TriangleMesh {
+public:
+    // Attribute locations shared with the shaders in Shaders
+    static constexpr GLuint kPositionAttribute = 0;
+    static constexpr GLuint kTransformAttribute = 1;  // Four consecutive vec4 columns
+    static constexpr GLuint kColorAttribute = 5;
+    static constexpr GLuint kNormalAttribute = 6;
+    static constexpr GLuint kTexCoordAttribute = 7;
+    static constexpr GLuint kVertexColorAttribute = 8;
+
+private:
+    GLuint mVAO = 0;
+    GLuint mVBO = 0;
+    GLuint mIBO = 0;
+    GLuint mInstanceVBO = 0;
+    VertexLayout mLayout;
+    GLsizei mVertexCount = 0;
+    GLsizei mIndexCount = 0;
+    GLenum mIndexType = GL_UNSIGNED_SHORT;
+    GLsizei mMaxInstances = 0;
+
+    // Points the instance attributes of the bound VAO at the bound GL_ARRAY_BUFFER
+    static void setInstanceAttributes(GLintptr baseOffset) {
+        for (GLuint column = 0; column < 4; ++column) {
+            glVertexAttribPointer(kTransformAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  reinterpret_cast<const void*>(baseOffset + offsetof(InstanceData, transform) +
+                                                                column * 4 * sizeof(float)));
+        }
+        glVertexAttribPointer(kColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              reinterpret_cast<const void*>(baseOffset + offsetof(InstanceData, color)));
+    }
+
+public:
+    // Vertex data for triangle, also drawn by the Vulkan renderer
+    static constexpr float vertices[] = {
+         0.0f,  0.5f, 0.0f,  // top
+        -0.5f, -0.5f, 0.0f,  // left
+         0.5f, -0.5f, 0.0f   // right
+    };
+
+    TriangleMesh() = default;
+    ~TriangleMesh() {
+        cleanup();
+    }
+
+    bool initialize() {
+        return initialize(vertices, 3);
+    }
+
+    // Arbitrary triangle list of tightly packed float[3] positions
+    bool initialize(const float* positions, GLsizei vertexCount) {
+        return initialize(positions, vertexCount, VertexLayout::positions());
+    }
+
+    // Interleaved vertices in the given layout, optionally indexed with GL_UNSIGNED_SHORT or
+    // GL_UNSIGNED_INT indices; without indices the vertices are drawn as a triangle list
+    bool initialize(const void* vertices, GLsizei vertexCount, const VertexLayout& layout,
+                    const void* indices = nullptr, GLsizei indexCount = 0, GLenum indexType = GL_UNSIGNED_SHORT) {
+        return uploadBuffers(vertices, vertexCount, layout, indices, indexCount, indexType) && createVertexArray();
+    }
+
+    // First half of initialize(): only creates the buffers, which unlike the VAO can be
+    // shared, so this may run on a loader thread with a context shared with the renderer's
+    bool uploadBuffers(const void* vertices, GLsizei vertexCount, const VertexLayout& layout,
+                       const void* indices = nullptr, GLsizei indexCount = 0, GLenum indexType = GL_UNSIGNED_SHORT) {
+        mLayout = layout;
+        mVertexCount = vertexCount;
+        mIndexCount = indices ? indexCount : 0;
+        mIndexType = indexType;
+
+        GLStateCache& state = GLStateCache::current();
+        glGenBuffers(1, &mVBO);
+        state.bindBuffer(GL_ARRAY_BUFFER, mVBO);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCount) * layout.stride(), vertices,
+                     GL_STATIC_DRAW);
+
+        if (mIndexCount > 0) {
+            // Bound as a copy target so no VAO's element array binding is touched
+            GLsizeiptr indexSize = indexType == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+            glGenBuffers(1, &mIBO);
+            state.bindBuffer(GL_COPY_WRITE_BUFFER, mIBO);
+            glBufferData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+        }
+        return mVBO != 0 && (mIndexCount == 0 || mIBO != 0);
+    }
+
+    // Second half of initialize(), on the context that draws the mesh
+    bool createVertexArray() {
+        glGenVertexArrays(1, &mVAO);
+
+        GLStateCache& state = GLStateCache::current();
+        state.bindVertexArray(mVAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, mVBO);
+        mLayout.apply(0);
+        if (mIBO) {
+            // The element array binding is recorded in the VAO
+            state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+        }
+        state.bindVertexArray(0);
+
+        return mVAO != 0;
+    }
+
+    // False until createVertexArray() ran, e.g. while an asynchronous upload is in flight
+    [[nodiscard]]
+    bool isReady() const {
+        return mVAO != 0;
+    }
+
+    // Leaves the VAO bound; the state cache skips the rebind when the next draw uses it again
+    void draw() const {
+        GLStateCache::current().bindVertexArray(mVAO);
+        if (mIndexCount > 0) {
+            glDrawElements(GL_TRIANGLES, mIndexCount, mIndexType, nullptr);
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
+        }
+    }
+
+    // Adds a per-instance attribute buffer to the VAO for up to maxInstances copies
+    bool enableInstancing(GLsizei maxInstances) {
+        mMaxInstances = maxInstances;
+        glGenBuffers(1, &mInstanceVBO);
+
+        GLStateCache& state = GLStateCache::current();
+        state.bindVertexArray(mVAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        setInstanceAttributes(0);
+        for (GLuint location = kTransformAttribute; location <= kColorAttribute; ++location) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        state.bindVertexArray(0);
+
+        return mInstanceVBO != 0;
+    }
+
+    // Sources vertices in the mesh's layout from another buffer, e.g. a StreamBuffer
+    // allocation rewritten every frame; indices, if any, still come from the mesh
+    void bindVertexSource(GLuint buffer, GLintptr offset, GLsizei vertexCount) {
+        mVertexCount = vertexCount;
+        GLStateCache& state = GLStateCache::current();
+        state.bindVertexArray(mVAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        mLayout.apply(offset);
+    }
+
+    // Sources instance attributes from another buffer; requires enableInstancing()
+    void bindInstanceSource(GLuint buffer, GLintptr offset) {
+        GLStateCache& state = GLStateCache::current();
+        state.bindVertexArray(mVAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        setInstanceAttributes(offset);
+    }
+
+    void updateInstances(const InstanceData* instances, GLsizei count) {
+        GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (count < mMaxInstances ? count : mMaxInstances) * sizeof(InstanceData),
+                        instances);
+    }
+
+    // One draw call for every instance; the count must fit the bound instance source
+    void drawInstanced(GLsizei instanceCount) const {
+        GLStateCache::current().bindVertexArray(mVAO);
+        if (mIndexCount > 0) {
+            glDrawElementsInstanced(GL_TRIANGLES, mIndexCount, mIndexType, nullptr, instanceCount);
+        } else {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, mVertexCount, instanceCount);
+        }
+    }
+
+    // Draws with the command at offset in the bound GL_DRAW_INDIRECT_BUFFER, a
+    // DrawElementsIndirectCommand for indexed meshes and a DrawArraysIndirectCommand otherwise
+    void drawIndirect(GLintptr offset) const {
+        GLStateCache::current().bindVertexArray(mVAO);
+        const void* command = reinterpret_cast<const void*>(offset);
+        if (mIndexCount > 0) {
+            glDrawElementsIndirect(GL_TRIANGLES, mIndexType, command);
+        } else {
+            glDrawArraysIndirect(GL_TRIANGLES, command);
+        }
+    }
+
+    [[nodiscard]]
+    GLsizei vertexCount() const {
+        return mVertexCount;
+    }
+
+    // Vertices per instance as the draw calls see them
+    [[nodiscard]]
+    GLsizei drawCount() const {
+        return mIndexCount > 0 ? mIndexCount : mVertexCount;
+    }
+
+    void cleanup() {
+        GLStateCache& state = GLStateCache::current();
+        if (mInstanceVBO) {
+            state.onBufferDeleted(mInstanceVBO);
+            glDeleteBuffers(1, &mInstanceVBO);
+            mInstanceVBO = 0;
+        }
+
+        if (mVBO) {
+            state.onBufferDeleted(mVBO);
+            glDeleteBuffers(1, &mVBO);
+            mVBO = 0;
+        }
+
+        if (mIBO) {
+            state.onBufferDeleted(mIBO);
+            glDeleteBuffers(1, &mIBO);
+            mIBO = 0;
+        }
+        
+        if (mVAO) {
+            state.onVertexArrayDeleted(mVAO);
+            glDeleteVertexArrays(1, &mVAO);
+            mVAO = 0;
+        }
+    }
+
+    // Forget the buffers without deleting them, for when their context is already gone
+    void invalidate() {
+        mInstanceVBO = 0;
+        mVBO = 0;
+        mIBO = 0;
+        mVAO = 0;
+    }
+};
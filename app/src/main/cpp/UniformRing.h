@@ -0,0 +1,87 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+#include "Uniforms.h"
+
+// Per-frame uniform constants, written in bulk and bound by offset.
+// A frame's blocks are sub-allocated from a StreamBuffer segment, each one starting on
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so any of them can be handed to a block with
+// glBindBufferRange. Writing every block of a frame in one pass replaces a glUniform
+// call per draw, and switching a draw's constants becomes a single range bind.
+class UniformRing {
+private:
+    StreamBuffer mStream;
+    GLsizeiptr mAlignment = 256;
+
+public:
+    UniformRing() = default;
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Must be called with a current context; never less than a vec4, which std140 relies on
+    static GLsizeiptr offsetAlignment() {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return std::max<GLsizeiptr>(alignment, 16);
+    }
+
+    // Must be called with a current context; sized for maxBlocks per frame of up to maxBlockSize each
+    bool initialize(size_t maxBlocks, GLsizeiptr maxBlockSize) {
+        mAlignment = offsetAlignment();
+        // Segments start on a multiple of their size, which keeps every offset aligned
+        return mStream.initialize(GL_UNIFORM_BUFFER, stride(maxBlockSize) * static_cast<GLsizeiptr>(maxBlocks));
+    }
+
+    // Distance between consecutive blocks of this size
+    [[nodiscard]]
+    GLsizeiptr stride(GLsizeiptr blockSize) const {
+        return (blockSize + mAlignment - 1) / mAlignment * mAlignment;
+    }
+
+    void beginFrame() {
+        mStream.beginFrame();
+    }
+
+    // Room for count consecutive blocks; nullptr data when the frame's segment is full
+    StreamBuffer::Allocation allocate(GLsizeiptr blockSize, size_t count = 1) {
+        return mStream.allocate(stride(blockSize) * static_cast<GLsizeiptr>(count), mAlignment);
+    }
+
+    template<typename Block>
+    Block* element(const StreamBuffer::Allocation& allocation, size_t index) const {
+        return reinterpret_cast<Block*>(static_cast<uint8_t*>(allocation.data) +
+                                        stride(sizeof(Block)) * static_cast<GLsizeiptr>(index));
+    }
+
+    // Must be called before anything binds from the allocation
+    void commit(const StreamBuffer::Allocation& allocation) {
+        mStream.commit(allocation);
+    }
+
+    // Points a block at the index-th element of an allocation
+    void bind(UniformBlock block, const StreamBuffer::Allocation& allocation, size_t index, GLsizeiptr blockSize) {
+        GLintptr offset = allocation.offset + stride(blockSize) * static_cast<GLintptr>(index);
+        glBindBufferRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(block), mStream.buffer(), offset, blockSize);
+        GLStateCache::current().onIndexedBufferBound(GL_UNIFORM_BUFFER, mStream.buffer());
+    }
+
+    // Fences the frame's blocks once everything using them has been drawn
+    void endFrame() {
+        mStream.endFrame();
+    }
+
+    void cleanup() {
+        mStream.cleanup();
+    }
+
+    void invalidate() {
+        mStream.invalidate();
+    }
+};
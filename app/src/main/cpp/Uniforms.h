@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cstddef>
+#include <cstring>
+
+// Uniform blocks shared by the shaders and the code that fills them.
+// Every block has a fixed binding point, assigned by name when a program is linked,
+// so a buffer range bound to a block stays valid across program switches.
+// The structs follow std140, which only needs vec4-sized members to match C++.
+enum class UniformBlock : GLuint {
+    Frame = 0,  // Constants shared by every draw of a frame
+    Batch = 1,  // Constants of one batch
+    Count
+};
+
+// Block names as declared in GLSL, indexed by UniformBlock
+inline constexpr const char* kUniformBlockNames[] = {"FrameUniforms", "BatchUniforms"};
+
+inline bool uniformBlockFromName(const char* name, UniformBlock& block) {
+    for (size_t i = 0; i < static_cast<size_t>(UniformBlock::Count); ++i) {
+        if (strcmp(name, kUniformBlockNames[i]) == 0) {
+            block = static_cast<UniformBlock>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+struct FrameUniforms {
+    float viewProjection[16];  // Column major
+};
+
+struct BatchUniforms {
+    float tint[4];
+};
+
+// Sizes the linked blocks are checked against, indexed by UniformBlock
+inline constexpr size_t kUniformBlockSizes[] = {sizeof(FrameUniforms), sizeof(BatchUniforms)};
+
+static_assert(sizeof(FrameUniforms) == 64, "FrameUniforms must match the std140 block");
+static_assert(sizeof(BatchUniforms) == 16, "BatchUniforms must match the std140 block");
+
+// Values that leave the instance transforms and colours unchanged
+inline constexpr FrameUniforms kDefaultFrameUniforms = {{
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+}};
+inline constexpr BatchUniforms kDefaultBatchUniforms = {{1.0f, 1.0f, 1.0f, 1.0f}};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Storage formats for vertex attributes, smallest first where precision allows
+enum class VertexFormat : uint8_t {
+    Float2,
+    Float3,
+    Float4,
+    Half2,
+    Half4,          // Positions; the fourth half keeps the attribute 4-byte aligned
+    Int2101010,     // Signed normalized xyz + 2-bit w, for normals and tangents
+    UByte4Norm,     // Colors
+    UShort2Norm,    // Texture coordinates in [0, 1]
+};
+
+struct VertexAttribute {
+    GLuint location;
+    VertexFormat format;
+    GLuint offset;
+};
+
+// Interleaved vertex layout: which attributes a vertex has, where they sit and the stride.
+// apply() is the one place that turns a layout into glVertexAttribPointer calls.
+class VertexLayout {
+public:
+    static constexpr size_t kMaxAttributes = 8;
+
+private:
+    struct FormatInfo {
+        GLint components;
+        GLenum type;
+        GLboolean normalized;
+        GLuint size;
+    };
+
+    VertexAttribute mAttributes[kMaxAttributes] = {};
+    size_t mCount = 0;
+    GLuint mStride = 0;
+
+    static FormatInfo formatInfo(VertexFormat format) {
+        switch (format) {
+            case VertexFormat::Float2: return {2, GL_FLOAT, GL_FALSE, 8};
+            case VertexFormat::Float3: return {3, GL_FLOAT, GL_FALSE, 12};
+            case VertexFormat::Float4: return {4, GL_FLOAT, GL_FALSE, 16};
+            case VertexFormat::Half2: return {2, GL_HALF_FLOAT, GL_FALSE, 4};
+            case VertexFormat::Half4: return {4, GL_HALF_FLOAT, GL_FALSE, 8};
+            case VertexFormat::Int2101010: return {4, GL_INT_2_10_10_10_REV, GL_TRUE, 4};
+            case VertexFormat::UByte4Norm: return {4, GL_UNSIGNED_BYTE, GL_TRUE, 4};
+            case VertexFormat::UShort2Norm: return {2, GL_UNSIGNED_SHORT, GL_TRUE, 4};
+        }
+        return {0, GL_FLOAT, GL_FALSE, 0};
+    }
+
+public:
+    // Tightly packed float[3] positions, the layout of every mesh before layouts existed
+    static VertexLayout positions() {
+        VertexLayout layout;
+        layout.add(0, VertexFormat::Float3);
+        return layout;
+    }
+
+    // Appends an attribute after the previous ones; every format is a multiple of 4 bytes
+    VertexLayout& add(GLuint location, VertexFormat format) {
+        if (mCount < kMaxAttributes) {
+            mAttributes[mCount++] = {location, format, mStride};
+            mStride += formatInfo(format).size;
+        }
+        return *this;
+    }
+
+    [[nodiscard]]
+    GLuint stride() const {
+        return mStride;
+    }
+
+    // Points the attributes of the bound VAO at the bound GL_ARRAY_BUFFER, starting at baseOffset
+    void apply(GLintptr baseOffset) const {
+        for (size_t i = 0; i < mCount; ++i) {
+            const VertexAttribute& attribute = mAttributes[i];
+            FormatInfo info = formatInfo(attribute.format);
+            glVertexAttribPointer(attribute.location, info.components, info.type, info.normalized,
+                                  static_cast<GLsizei>(mStride),
+                                  reinterpret_cast<const void*>(baseOffset + attribute.offset));
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+};
+
+// Packing helpers for building quantized vertex data on the CPU
+namespace VertexPacking {
+    // IEEE 754 binary16, round to nearest; out-of-range values saturate to infinity
+    inline uint16_t toHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF) {
+            return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+        }
+        if (exponent >= 31) {
+            return static_cast<uint16_t>(sign | 0x7C00);
+        }
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            // Subnormal half
+            mantissa |= 0x800000;
+            uint32_t shift = static_cast<uint32_t>(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            if (remainder > (1u << (shift - 1)) || (remainder == (1u << (shift - 1)) && (half & 1))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            ++half;  // May carry into the exponent, which still rounds correctly
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // xyz in [-1, 1] to GL_INT_2_10_10_10_REV with w = 0
+    inline uint32_t toInt2101010(float x, float y, float z) {
+        auto pack = [](float v) {
+            float clamped = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+            auto snorm = static_cast<int32_t>(std::lround(clamped * 511.0f));
+            return static_cast<uint32_t>(snorm) & 0x3FF;
+        };
+        return pack(x) | (pack(y) << 10) | (pack(z) << 20);
+    }
+
+    // [0, 1] to a normalized unsigned integer with the given maximum
+    inline uint32_t toUnorm(float v, uint32_t max) {
+        float clamped = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        return static_cast<uint32_t>(std::lround(clamped * static_cast<float>(max)));
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#define VK_NO_PROTOTYPES
+#define VK_USE_PLATFORM_ANDROID_KHR
+#include <vulkan/vulkan.h>
+#include <dlfcn.h>
+
+#include "Log.h"
+
+// Every Vulkan entry point the renderer calls, by the level it is resolved at
+#define VULKAN_GLOBAL_FUNCTIONS(X) \
+    X(vkCreateInstance) \
+    X(vkEnumerateInstanceVersion)
+
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkCreateDevice) \
+    X(vkGetDeviceProcAddr) \
+    X(vkCreateAndroidSurfaceKHR) \
+    X(vkDestroySurfaceKHR) \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR)
+
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkDeviceWaitIdle) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR) \
+    X(vkQueueSubmit) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkCreateRenderPass) \
+    X(vkDestroyRenderPass) \
+    X(vkCreateFramebuffer) \
+    X(vkDestroyFramebuffer) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkGetPipelineCacheData) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkResetCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdBindVertexBuffers) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkCmdPushConstants) \
+    X(vkCmdDraw) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkBindBufferMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory)
+
+// Vulkan entry points resolved at runtime.
+// libvulkan.so only ships from API 24 and minSdk is 21, so nothing links against it;
+// load() fails cleanly on devices without it and the GLES renderer is used instead.
+class VulkanFunctions {
+private:
+    void* mLibrary = nullptr;
+    PFN_vkGetInstanceProcAddr mGetInstanceProcAddr = nullptr;
+
+public:
+#define VULKAN_DECLARE(name) PFN_##name name = nullptr;
+    VULKAN_GLOBAL_FUNCTIONS(VULKAN_DECLARE)
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE)
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE)
+#undef VULKAN_DECLARE
+
+    VulkanFunctions() = default;
+    ~VulkanFunctions() {
+        if (mLibrary) {
+            dlclose(mLibrary);
+        }
+    }
+
+    VulkanFunctions(const VulkanFunctions&) = delete;
+    VulkanFunctions& operator=(const VulkanFunctions&) = delete;
+
+    bool load() {
+        if (mGetInstanceProcAddr) {
+            return true;
+        }
+        mLibrary = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+        if (!mLibrary) {
+            return false;
+        }
+        mGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(mLibrary, "vkGetInstanceProcAddr"));
+        if (!mGetInstanceProcAddr) {
+            return false;
+        }
+#define VULKAN_LOAD(name) name = reinterpret_cast<PFN_##name>(mGetInstanceProcAddr(VK_NULL_HANDLE, #name));
+        VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD)
+#undef VULKAN_LOAD
+        // vkEnumerateInstanceVersion is missing from 1.0 loaders, which is how 1.0 is detected
+        return vkCreateInstance != nullptr;
+    }
+
+    bool loadInstance(VkInstance instance) {
+        bool complete = true;
+#define VULKAN_LOAD(name) \
+        name = reinterpret_cast<PFN_##name>(mGetInstanceProcAddr(instance, #name)); \
+        complete = complete && name != nullptr;
+        VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD)
+#undef VULKAN_LOAD
+        return complete;
+    }
+
+    bool loadDevice(VkDevice device) {
+        bool complete = true;
+#define VULKAN_LOAD(name) \
+        name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)); \
+        complete = complete && name != nullptr;
+        VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD)
+#undef VULKAN_LOAD
+        if (!complete) {
+            LOG_ERROR("Vulkan device is missing entry points");
+        }
+        return complete;
+    }
+
+    // Instance-level API version of the loader, 1.0 when it predates vkEnumerateInstanceVersion
+    [[nodiscard]]
+    uint32_t instanceVersion() const {
+        uint32_t version = VK_API_VERSION_1_0;
+        if (vkEnumerateInstanceVersion) {
+            vkEnumerateInstanceVersion(&version);
+        }
+        return version;
+    }
+};
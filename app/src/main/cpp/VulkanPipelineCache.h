@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Log.h"
+#include "VulkanFunctions.h"
+
+// VkPipelineCache persisted to a file, the Vulkan side of ProgramCache.
+// The blob starts with the header the spec defines, so a blob from another driver or
+// device is recognised and dropped here rather than handed to a driver that may not cope.
+class VulkanPipelineCache {
+private:
+    // VkPipelineCacheHeaderVersionOne
+    struct Header {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    const VulkanFunctions* mVk = nullptr;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkPipelineCache mCache = VK_NULL_HANDLE;
+    std::string mPath;
+
+    static std::vector<char> read(const std::string& path, const VkPhysicalDeviceProperties& properties) {
+        std::vector<char> data;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return data;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+        bool valid = !data.empty() && fread(data.data(), data.size(), 1, file) == 1;
+        fclose(file);
+
+        Header header{};
+        if (valid && data.size() >= sizeof(header)) {
+            memcpy(&header, data.data(), sizeof(header));
+            valid = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                    header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+                    memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            LOG_INFO("Discarding pipeline cache %s from another driver", path.c_str());
+            remove(path.c_str());
+            data.clear();
+        }
+        return data;
+    }
+
+public:
+    VulkanPipelineCache() = default;
+    ~VulkanPipelineCache() {
+        cleanup();
+    }
+
+    VulkanPipelineCache(const VulkanPipelineCache&) = delete;
+    VulkanPipelineCache& operator=(const VulkanPipelineCache&) = delete;
+
+    // Without a data path the cache still works, it just starts empty every run
+    bool initialize(const VulkanFunctions& vk, VkDevice device, const VkPhysicalDeviceProperties& properties,
+                    const char* dataPath) {
+        mVk = &vk;
+        mDevice = device;
+        mPath = dataPath ? std::string(dataPath) + "/pipeline_cache.bin" : std::string();
+        std::vector<char> data = mPath.empty() ? std::vector<char>() : read(mPath, properties);
+
+        VkPipelineCacheCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.empty() ? nullptr : data.data();
+        if (vk.vkCreatePipelineCache(device, &createInfo, nullptr, &mCache) != VK_SUCCESS) {
+            LOG_ERROR("Failed to create pipeline cache");
+            mCache = VK_NULL_HANDLE;
+            return false;
+        }
+        LOG_INFO("Pipeline cache loaded %zu bytes", data.size());
+        return true;
+    }
+
+    // Writes the cache out, through a temporary file like ProgramCache::store()
+    void save() const {
+        if (mCache == VK_NULL_HANDLE || mPath.empty()) {
+            return;
+        }
+        size_t size = 0;
+        if (mVk->vkGetPipelineCacheData(mDevice, mCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return;
+        }
+        std::vector<char> data(size);
+        if (mVk->vkGetPipelineCacheData(mDevice, mCache, &size, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::string tempPath = mPath + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            LOG_ERROR("Failed to write pipeline cache %s", tempPath.c_str());
+            return;
+        }
+        bool written = fwrite(data.data(), size, 1, file) == 1;
+        written = fclose(file) == 0 && written;
+        if (!written || rename(tempPath.c_str(), mPath.c_str()) != 0) {
+            LOG_ERROR("Failed to write pipeline cache %s", mPath.c_str());
+            remove(tempPath.c_str());
+        }
+    }
+
+    void cleanup() {
+        if (mCache != VK_NULL_HANDLE) {
+            mVk->vkDestroyPipelineCache(mDevice, mCache, nullptr);
+            mCache = VK_NULL_HANDLE;
+        }
+    }
+
+    [[nodiscard]]
+    VkPipelineCache get() const {
+        return mCache;
+    }
+};
@@ -0,0 +1,934 @@
+#pragma once
+
+#include <android/native_window.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "Log.h"
+#include "Renderer.h"
+#include "ShaderModule.h"
+#include "SimdMath.h"
+#include "SpirvShaders.h"
+#include "TriangleMesh.h"
+#include "Uniforms.h"
+#include "VulkanFunctions.h"
+#include "VulkanPipelineCache.h"
+
+// Vulkan renderer class
+// The Vulkan backend, used instead of EGLRenderer when asked for and the device has Vulkan 1.1.
+// The instance, device and pipeline outlive the window like the EGL context does, and
+// only the surface and swapchain are rebuilt when the window comes and goes. Each of the
+// kFramesInFlight frames has its own command pool, fence and instance buffer, so the CPU
+// records a frame while the GPU is still drawing the previous one; drawFrame() only waits
+// when the GPU falls a whole ring behind.
+// It draws the same instanced scene with the same shaders, through SPIR-V built from
+// Shaders.h, whose uniform blocks become push constants; the packed scene mesh, textures,
+// HUD and benchmark stay GLES-only for now.
+class VulkanRenderer : public Renderer {
+private:
+    static constexpr uint32_t kFramesInFlight = 2;
+    static constexpr uint32_t kMaxInstances = 16384;
+    static constexpr uint32_t kMaxSwapchainImages = 8;
+    static constexpr uint32_t kObjectsPerJob = 256;
+
+    // Culls and composes one range of the scene on a worker
+    struct InstanceJob {
+        VulkanRenderer* renderer;
+
+        void operator()(uint32_t begin, uint32_t end) const {
+            renderer->prepareInstances(begin, end);
+        }
+    };
+
+    struct Frame {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;  // Signalled when the GPU is done with this frame
+        VkSemaphore imageAcquired = VK_NULL_HANDLE;
+        VkBuffer instanceBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+        InstanceData* instances = nullptr;  // Persistently mapped, host coherent
+    };
+
+    VulkanFunctions mVk;
+    VkInstance mInstance = VK_NULL_HANDLE;
+    VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties mProperties = {};
+    uint32_t mQueueFamily = 0;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkQueue mQueue = VK_NULL_HANDLE;
+
+    ANativeWindow* mWindow = nullptr;
+    VkSurfaceKHR mSurface = VK_NULL_HANDLE;
+    VkSwapchainKHR mSwapchain = VK_NULL_HANDLE;
+    VkFormat mSwapchainFormat = VK_FORMAT_UNDEFINED;
+    VkExtent2D mExtent = {};
+    uint32_t mImageCount = 0;
+    VkImageView mImageViews[kMaxSwapchainImages] = {};
+    VkFramebuffer mFramebuffers[kMaxSwapchainImages] = {};
+    VkSemaphore mRenderFinished[kMaxSwapchainImages] = {};  // Per image, reused once it is acquired again
+    bool mSwapchainDirty = false;
+
+    VkRenderPass mRenderPass = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+    VulkanPipelineCache mPipelineCache;
+    VkBuffer mVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory mVertexMemory = VK_NULL_HANDLE;
+    Frame mFrames[kFramesInFlight];
+    uint32_t mFrameIndex = 0;
+
+    TransformSoA mSceneTransforms;
+    BoundsSoA mSceneBounds;
+    std::vector<InstanceData> mSceneInstances;  // Only the colors are used
+    // Per job range: the visible objects, compacted to the front of the range
+    std::vector<uint32_t> mVisible;
+    std::vector<InstanceData> mStagedInstances;
+    std::vector<uint32_t> mVisibleCounts;
+    InstanceJob mInstanceJob{this};
+    JobCounter mInstanceCounter;
+    FrameUniforms mFrameUniforms = kDefaultFrameUniforms;  // Pushed with each frame's draws
+
+    static bool createInstance(VulkanFunctions& vk, VkInstance& instance) {
+        if (!vk.load() || vk.instanceVersion() < VK_API_VERSION_1_1) {
+            return false;
+        }
+
+        VkApplicationInfo appInfo = {};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "NativeApp";
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+
+        const char* extensions[] = {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_ANDROID_SURFACE_EXTENSION_NAME};
+        VkInstanceCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        createInfo.pApplicationInfo = &appInfo;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(std::size(extensions));
+        createInfo.ppEnabledExtensionNames = extensions;
+        if (vk.vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+            instance = VK_NULL_HANDLE;
+            return false;
+        }
+        if (!vk.loadInstance(instance)) {
+            // The instance may still be destroyable even when other entry points are missing
+            if (vk.vkDestroyInstance) {
+                vk.vkDestroyInstance(instance, nullptr);
+            }
+            instance = VK_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
+
+    static std::vector<VkPhysicalDevice> physicalDevices(const VulkanFunctions& vk, VkInstance instance) {
+        uint32_t count = 0;
+        vk.vkEnumeratePhysicalDevices(instance, &count, nullptr);
+        std::vector<VkPhysicalDevice> devices(count);
+        vk.vkEnumeratePhysicalDevices(instance, &count, devices.data());
+        devices.resize(count);
+        return devices;
+    }
+
+    // Picks the first 1.1 device with a queue that can both draw and present to mSurface
+    bool selectDevice() {
+        for (VkPhysicalDevice device : physicalDevices(mVk, mInstance)) {
+            VkPhysicalDeviceProperties properties;
+            mVk.vkGetPhysicalDeviceProperties(device, &properties);
+            if (properties.apiVersion < VK_API_VERSION_1_1) {
+                continue;
+            }
+
+            uint32_t familyCount = 0;
+            mVk.vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            mVk.vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+            for (uint32_t family = 0; family < familyCount; ++family) {
+                VkBool32 present = VK_FALSE;
+                mVk.vkGetPhysicalDeviceSurfaceSupportKHR(device, family, mSurface, &present);
+                if ((families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT) && present) {
+                    mPhysicalDevice = device;
+                    mProperties = properties;
+                    mQueueFamily = family;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool createDevice() {
+        const float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = mQueueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+
+        const char* extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        VkDeviceCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.queueCreateInfoCount = 1;
+        createInfo.pQueueCreateInfos = &queueInfo;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(std::size(extensions));
+        createInfo.ppEnabledExtensionNames = extensions;
+        if (mVk.vkCreateDevice(mPhysicalDevice, &createInfo, nullptr, &mDevice) != VK_SUCCESS) {
+            LOG_ERROR("Failed to create Vulkan device");
+            mDevice = VK_NULL_HANDLE;
+            return false;
+        }
+        if (!mVk.loadDevice(mDevice)) {
+            return false;
+        }
+        mVk.vkGetDeviceQueue(mDevice, mQueueFamily, 0, &mQueue);
+        LOG_INFO("Vulkan device: %s, API %u.%u", mProperties.deviceName, VK_VERSION_MAJOR(mProperties.apiVersion),
+                 VK_VERSION_MINOR(mProperties.apiVersion));
+        return true;
+    }
+
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory,
+                      void** mapped) {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (mVk.vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            buffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        // Host-visible and coherent, so writes need no flush; mobile GPUs share the memory anyway
+        VkMemoryRequirements requirements;
+        mVk.vkGetBufferMemoryRequirements(mDevice, buffer, &requirements);
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        mVk.vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memoryProperties);
+        const VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        uint32_t typeIndex = memoryProperties.memoryTypeCount;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            if ((requirements.memoryTypeBits & (1u << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                typeIndex = i;
+                break;
+            }
+        }
+
+        VkMemoryAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize = requirements.size;
+        allocateInfo.memoryTypeIndex = typeIndex;
+        if (typeIndex == memoryProperties.memoryTypeCount ||
+            mVk.vkAllocateMemory(mDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+            memory = VK_NULL_HANDLE;
+            return false;
+        }
+        return mVk.vkBindBufferMemory(mDevice, buffer, memory, 0) == VK_SUCCESS &&
+               mVk.vkMapMemory(mDevice, memory, 0, VK_WHOLE_SIZE, 0, mapped) == VK_SUCCESS;
+    }
+
+    void destroyBuffer(VkBuffer& buffer, VkDeviceMemory& memory) {
+        if (buffer != VK_NULL_HANDLE) {
+            mVk.vkDestroyBuffer(mDevice, buffer, nullptr);
+            buffer = VK_NULL_HANDLE;
+        }
+        if (memory != VK_NULL_HANDLE) {
+            // Freeing mapped memory unmaps it implicitly
+            mVk.vkFreeMemory(mDevice, memory, nullptr);
+            memory = VK_NULL_HANDLE;
+        }
+    }
+
+    bool createRenderPass() {
+        VkAttachmentDescription color = {};
+        color.format = mSwapchainFormat;
+        color.samples = VK_SAMPLE_COUNT_1_BIT;
+        color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        color.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+
+        // The layout transition waits for the acquire semaphore, which is signalled at this stage
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        createInfo.attachmentCount = 1;
+        createInfo.pAttachments = &color;
+        createInfo.subpassCount = 1;
+        createInfo.pSubpasses = &subpass;
+        createInfo.dependencyCount = 1;
+        createInfo.pDependencies = &dependency;
+        return mVk.vkCreateRenderPass(mDevice, &createInfo, nullptr, &mRenderPass) == VK_SUCCESS;
+    }
+
+    // The instanced pipeline, with the attribute layout of TriangleMesh::enableInstancing()
+    bool createPipeline() {
+        ShaderModule vertexShader;
+        ShaderModule fragmentShader;
+        if (!vertexShader.initialize(mVk, mDevice, SpirvShaders::instancedVertexShader,
+                                     sizeof(SpirvShaders::instancedVertexShader)) ||
+            !fragmentShader.initialize(mVk, mDevice, SpirvShaders::instancedFragmentShader,
+                                       sizeof(SpirvShaders::instancedFragmentShader))) {
+            return false;
+        }
+
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vertexShader.get();
+        stages[0].pName = "main";
+        stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fragmentShader.get();
+        stages[1].pName = "main";
+
+        const VkVertexInputBindingDescription bindings[] = {
+            {0, 3 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX},
+            {1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE},
+        };
+        VkVertexInputAttributeDescription attributes[6] = {};
+        attributes[0] = {TriangleMesh::kPositionAttribute, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+        for (uint32_t column = 0; column < 4; ++column) {
+            attributes[1 + column] = {TriangleMesh::kTransformAttribute + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                      static_cast<uint32_t>(offsetof(InstanceData, transform) +
+                                                            column * 4 * sizeof(float))};
+        }
+        attributes[5] = {TriangleMesh::kColorAttribute, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                         static_cast<uint32_t>(offsetof(InstanceData, color))};
+
+        VkPipelineVertexInputStateCreateInfo vertexInput = {};
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(std::size(bindings));
+        vertexInput.pVertexBindingDescriptions = bindings;
+        vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(std::size(attributes));
+        vertexInput.pVertexAttributeDescriptions = attributes;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPipelineViewportStateCreateInfo viewport = {};
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo rasterization = {};
+        rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_NONE;
+        rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterization.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisample = {};
+        multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState blendAttachment = {};
+        blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        VkPipelineColorBlendStateCreateInfo blend = {};
+        blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        blend.attachmentCount = 1;
+        blend.pAttachments = &blendAttachment;
+
+        // Viewport and scissor follow the swapchain, so resizing never rebuilds the pipeline
+        const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamic = {};
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = static_cast<uint32_t>(std::size(dynamicStates));
+        dynamic.pDynamicStates = dynamicStates;
+
+        // The GLES uniform blocks, packed one after the other as the shaders declare them
+        const VkPushConstantRange pushConstants[] = {
+            {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(FrameUniforms)},
+            {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(FrameUniforms), sizeof(BatchUniforms)},
+        };
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.pushConstantRangeCount = 2;
+        layoutInfo.pPushConstantRanges = pushConstants;
+        if (mVk.vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
+            mPipelineLayout = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkGraphicsPipelineCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        createInfo.stageCount = static_cast<uint32_t>(std::size(stages));
+        createInfo.pStages = stages;
+        createInfo.pVertexInputState = &vertexInput;
+        createInfo.pInputAssemblyState = &inputAssembly;
+        createInfo.pViewportState = &viewport;
+        createInfo.pRasterizationState = &rasterization;
+        createInfo.pMultisampleState = &multisample;
+        createInfo.pColorBlendState = &blend;
+        createInfo.pDynamicState = &dynamic;
+        createInfo.layout = mPipelineLayout;
+        createInfo.renderPass = mRenderPass;
+        createInfo.subpass = 0;
+        if (mVk.vkCreateGraphicsPipelines(mDevice, mPipelineCache.get(), 1, &createInfo, nullptr, &mPipeline) !=
+            VK_SUCCESS) {
+            mPipeline = VK_NULL_HANDLE;
+            return false;
+        }
+        // Saved now rather than at cleanup, which Android often kills the process before reaching
+        mPipelineCache.save();
+        return true;
+    }
+
+    // Created signalled, so the first wait on it returns at once
+    bool createSignalledFence(VkFence& fence) {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        if (mVk.vkCreateFence(mDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            fence = VK_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
+
+    bool createSemaphore(VkSemaphore& semaphore) {
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (mVk.vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+            semaphore = VK_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
+
+    bool createFrames() {
+        for (Frame& frame : mFrames) {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = mQueueFamily;
+            if (mVk.vkCreateCommandPool(mDevice, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+                frame.commandPool = VK_NULL_HANDLE;
+                return false;
+            }
+
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.commandPool = frame.commandPool;
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandBufferCount = 1;
+
+            void* mapped = nullptr;
+            if (mVk.vkAllocateCommandBuffers(mDevice, &allocateInfo, &frame.commandBuffer) != VK_SUCCESS ||
+                !createSignalledFence(frame.fence) ||
+                !createSemaphore(frame.imageAcquired) ||
+                !createBuffer(kMaxInstances * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                              frame.instanceBuffer, frame.instanceMemory, &mapped)) {
+                return false;
+            }
+            frame.instances = static_cast<InstanceData*>(mapped);
+        }
+        return true;
+    }
+
+    void destroyFrames() {
+        for (Frame& frame : mFrames) {
+            destroyBuffer(frame.instanceBuffer, frame.instanceMemory);
+            frame.instances = nullptr;
+            if (frame.imageAcquired != VK_NULL_HANDLE) {
+                mVk.vkDestroySemaphore(mDevice, frame.imageAcquired, nullptr);
+                frame.imageAcquired = VK_NULL_HANDLE;
+            }
+            if (frame.fence != VK_NULL_HANDLE) {
+                mVk.vkDestroyFence(mDevice, frame.fence, nullptr);
+                frame.fence = VK_NULL_HANDLE;
+            }
+            // Destroying the pool frees its command buffer
+            if (frame.commandPool != VK_NULL_HANDLE) {
+                mVk.vkDestroyCommandPool(mDevice, frame.commandPool, nullptr);
+                frame.commandPool = VK_NULL_HANDLE;
+                frame.commandBuffer = VK_NULL_HANDLE;
+            }
+        }
+    }
+
+    // Everything that survives the window, created once the first surface says which device to use
+    bool initializeDevice() {
+        if (!selectDevice()) {
+            LOG_ERROR("No Vulkan 1.1 device can present to this window");
+            return false;
+        }
+        if (!createDevice()) {
+            return false;
+        }
+        if (!chooseSurfaceFormat()) {
+            destroyDevice();
+            return false;
+        }
+        mPipelineCache.initialize(mVk, mDevice, mProperties, mApp->activity->internalDataPath);
+
+        // A half-built device is torn down, so the next window starts over instead of drawing without a pipeline
+        void* mapped = nullptr;
+        if (!createRenderPass() || !createPipeline() || !createFrames() ||
+            !createBuffer(sizeof(TriangleMesh::vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mVertexBuffer,
+                          mVertexMemory, &mapped)) {
+            LOG_ERROR("Failed to create Vulkan resources");
+            destroyDevice();
+            return false;
+        }
+        std::copy(std::begin(TriangleMesh::vertices), std::end(TriangleMesh::vertices), static_cast<float*>(mapped));
+
+        LOG_INFO("Vulkan resources initialized");
+        return true;
+    }
+
+    // Everything initializeDevice() created; the swapchain has to be gone already
+    void destroyDevice() {
+        if (mDevice == VK_NULL_HANDLE) {
+            return;
+        }
+        mPipelineCache.cleanup();
+        destroyFrames();
+        destroyBuffer(mVertexBuffer, mVertexMemory);
+        if (mPipeline != VK_NULL_HANDLE) {
+            mVk.vkDestroyPipeline(mDevice, mPipeline, nullptr);
+            mPipeline = VK_NULL_HANDLE;
+        }
+        if (mPipelineLayout != VK_NULL_HANDLE) {
+            mVk.vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+            mPipelineLayout = VK_NULL_HANDLE;
+        }
+        if (mRenderPass != VK_NULL_HANDLE) {
+            mVk.vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+            mRenderPass = VK_NULL_HANDLE;
+        }
+        mVk.vkDestroyDevice(mDevice, nullptr);
+        mDevice = VK_NULL_HANDLE;
+    }
+
+    // The swapchain format is picked once so the render pass and pipeline never change
+    bool chooseSurfaceFormat() {
+        uint32_t count = 0;
+        mVk.vkGetPhysicalDeviceSurfaceFormatsKHR(mPhysicalDevice, mSurface, &count, nullptr);
+        std::vector<VkSurfaceFormatKHR> formats(count);
+        mVk.vkGetPhysicalDeviceSurfaceFormatsKHR(mPhysicalDevice, mSurface, &count, formats.data());
+        if (count == 0) {
+            LOG_ERROR("Vulkan surface reports no formats");
+            return false;
+        }
+
+        // The same UNORM target the EGL config asks for, so both backends look alike
+        VkFormat wanted = mColorFormat == ColorFormat::Rgb565 ? VK_FORMAT_R5G6B5_UNORM_PACK16 : VK_FORMAT_R8G8B8A8_UNORM;
+        mSwapchainFormat = formats[0].format;
+        for (const VkSurfaceFormatKHR& format : formats) {
+            if (format.format == wanted) {
+                mSwapchainFormat = format.format;
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool createSwapchain() {
+        VkSurfaceCapabilitiesKHR capabilities;
+        if (mVk.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(mPhysicalDevice, mSurface, &capabilities) != VK_SUCCESS) {
+            return false;
+        }
+        mExtent = capabilities.currentExtent;
+        if (mExtent.width == 0xFFFFFFFF) {
+            mExtent = {static_cast<uint32_t>(ANativeWindow_getWidth(mWindow)),
+                       static_cast<uint32_t>(ANativeWindow_getHeight(mWindow))};
+        }
+        if (mExtent.width == 0 || mExtent.height == 0) {
+            return false;
+        }
+
+        // One image more than the frames in flight, so acquiring never waits on the display
+        uint32_t imageCount = std::max(capabilities.minImageCount, kFramesInFlight + 1);
+        if (capabilities.maxImageCount > 0) {
+            imageCount = std::min(imageCount, capabilities.maxImageCount);
+        }
+        imageCount = std::min(imageCount, kMaxSwapchainImages);
+
+        VkCompositeAlphaFlagBitsKHR compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+        if (capabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR) {
+            compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        }
+
+        // The display compositor rotates the identity-transformed image like it does the EGL surface;
+        // a transform mismatch only makes presents report VK_SUBOPTIMAL_KHR, which is ignored
+        VkSurfaceTransformFlagBitsKHR transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+        if (!(capabilities.supportedTransforms & transform)) {
+            transform = capabilities.currentTransform;
+        }
+
+        VkSwapchainKHR oldSwapchain = mSwapchain;
+        VkSwapchainCreateInfoKHR createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        createInfo.surface = mSurface;
+        createInfo.minImageCount = imageCount;
+        createInfo.imageFormat = mSwapchainFormat;
+        createInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        createInfo.imageExtent = mExtent;
+        createInfo.imageArrayLayers = 1;
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.preTransform = transform;
+        createInfo.compositeAlpha = compositeAlpha;
+        // FIFO is the only mode every device has, and the Choreographer paces on top of it
+        createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        createInfo.clipped = VK_TRUE;
+        createInfo.oldSwapchain = oldSwapchain;
+        VkResult result = mVk.vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapchain);
+        if (oldSwapchain != VK_NULL_HANDLE) {
+            mVk.vkDestroySwapchainKHR(mDevice, oldSwapchain, nullptr);
+        }
+        if (result != VK_SUCCESS) {
+            LOG_ERROR("Failed to create Vulkan swapchain (%d)", result);
+            mSwapchain = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkImage images[kMaxSwapchainImages];
+        mImageCount = kMaxSwapchainImages;
+        mVk.vkGetSwapchainImagesKHR(mDevice, mSwapchain, &mImageCount, images);
+        for (uint32_t i = 0; i < mImageCount; ++i) {
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = images[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = mSwapchainFormat;
+            viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = mRenderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &mImageViews[i];
+            framebufferInfo.width = mExtent.width;
+            framebufferInfo.height = mExtent.height;
+            framebufferInfo.layers = 1;
+
+            VkSemaphoreCreateInfo semaphoreInfo = {};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (mVk.vkCreateImageView(mDevice, &viewInfo, nullptr, &mImageViews[i]) != VK_SUCCESS ||
+                mVk.vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mFramebuffers[i]) != VK_SUCCESS ||
+                mVk.vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderFinished[i]) != VK_SUCCESS) {
+                LOG_ERROR("Failed to create swapchain image resources");
+                return false;
+            }
+        }
+
+        mSwapchainDirty = false;
+        LOG_INFO("Vulkan swapchain %ux%u with %u images", mExtent.width, mExtent.height, mImageCount);
+        return true;
+    }
+
+    // Keeps the swapchain itself so it can be handed to the next one as oldSwapchain
+    void destroySwapchainImages() {
+        for (uint32_t i = 0; i < kMaxSwapchainImages; ++i) {
+            if (mRenderFinished[i] != VK_NULL_HANDLE) {
+                mVk.vkDestroySemaphore(mDevice, mRenderFinished[i], nullptr);
+                mRenderFinished[i] = VK_NULL_HANDLE;
+            }
+            if (mFramebuffers[i] != VK_NULL_HANDLE) {
+                mVk.vkDestroyFramebuffer(mDevice, mFramebuffers[i], nullptr);
+                mFramebuffers[i] = VK_NULL_HANDLE;
+            }
+            if (mImageViews[i] != VK_NULL_HANDLE) {
+                mVk.vkDestroyImageView(mDevice, mImageViews[i], nullptr);
+                mImageViews[i] = VK_NULL_HANDLE;
+            }
+        }
+        mImageCount = 0;
+    }
+
+    // Rare (rotation, resize), so simply waits for the GPU to let go of the old images
+    bool recreateSwapchain() {
+        mVk.vkDeviceWaitIdle(mDevice);
+        destroySwapchainImages();
+        return createSwapchain();
+    }
+
+    bool attachWindow(ANativeWindow* window) override {
+        if (mInstance == VK_NULL_HANDLE && !createInstance(mVk, mInstance)) {
+            LOG_ERROR("Failed to create Vulkan instance");
+            return false;
+        }
+
+        mWindow = window;
+        VkAndroidSurfaceCreateInfoKHR surfaceInfo = {};
+        surfaceInfo.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
+        surfaceInfo.window = window;
+        if (mVk.vkCreateAndroidSurfaceKHR(mInstance, &surfaceInfo, nullptr, &mSurface) != VK_SUCCESS) {
+            LOG_ERROR("Failed to create Vulkan surface");
+            mSurface = VK_NULL_HANDLE;
+            return false;
+        }
+
+        if (mDevice == VK_NULL_HANDLE && !initializeDevice()) {
+            return false;
+        }
+        if (!createSwapchain()) {
+            return false;
+        }
+
+        LOG_INFO("Window surface attached");
+        return true;
+    }
+
+    void detachWindow() override {
+        if (mDevice != VK_NULL_HANDLE) {
+            mVk.vkDeviceWaitIdle(mDevice);
+            destroySwapchainImages();
+            if (mSwapchain != VK_NULL_HANDLE) {
+                mVk.vkDestroySwapchainKHR(mDevice, mSwapchain, nullptr);
+                mSwapchain = VK_NULL_HANDLE;
+            }
+        }
+        if (mSurface != VK_NULL_HANDLE) {
+            mVk.vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+            mSurface = VK_NULL_HANDLE;
+            LOG_INFO("Vulkan surface destroyed");
+        }
+        mWindow = nullptr;
+    }
+
+    void resize() override {
+        mSwapchainDirty = true;
+    }
+
+    // Culled first, so only the objects that are drawn pay for a matrix
+    void prepareInstances(uint32_t begin, uint32_t end) {
+        uint32_t* visible = mVisible.data() + begin;
+        InstanceData* staged = mStagedInstances.data() + begin;
+        uint32_t visibleCount = mCuller.cull(mSceneBounds, begin, end, visible);
+        composeIndexedTransforms(mSceneTransforms, visible, visibleCount, staged[0].transform,
+                                 sizeof(InstanceData) / sizeof(float));
+        for (uint32_t i = 0; i < visibleCount; ++i) {
+            const float* color = mSceneInstances[visible[i]].color;
+            std::copy(color, color + 4, staged[i].color);
+        }
+        mVisibleCounts[begin / kObjectsPerJob] = visibleCount;
+    }
+
+    // Prepares the scene on the workers like the GLES backend, then packs the visible
+    // instances of every range into the frame's mapped buffer
+    uint32_t writeInstances(Frame& frame) {
+        auto count = static_cast<uint32_t>(mSceneInstances.size());
+        mVisibleCounts.assign((count + kObjectsPerJob - 1) / kObjectsPerJob, 0);
+        mJobs.parallelFor(count, kObjectsPerJob, mInstanceCounter, mInstanceJob);
+        mJobs.wait(mInstanceCounter);
+
+        uint32_t written = 0;
+        for (size_t range = 0; range < mVisibleCounts.size(); ++range) {
+            uint32_t visibleCount = std::min(mVisibleCounts[range], kMaxInstances - written);
+            const InstanceData* staged = mStagedInstances.data() + range * kObjectsPerJob;
+            std::copy(staged, staged + visibleCount, frame.instances + written);
+            written += visibleCount;
+        }
+        return written;
+    }
+
+    // Same late latch as EGLRenderer: right before the frame is recorded, once the wait for its
+    // slot is over, so the pan pushed with the draws comes from the newest touch sample
+    void latchInput() {
+        mInput.update();
+        float panX = 0.0f;
+        float panY = 0.0f;
+        mInput.panOffset(nowNanos() + mFramePacer.framePeriodNs(), static_cast<float>(mExtent.width),
+                         static_cast<float>(mExtent.height), panX, panY);
+        Mat4 viewProjection = Mat4::translation({panX, panY, 0.0f});
+        std::copy(std::begin(viewProjection.m), std::end(viewProjection.m), mFrameUniforms.viewProjection);
+        mCuller.setViewProjection(viewProjection.m);
+    }
+
+    void recordCommands(Frame& frame, uint32_t imageIndex, uint32_t instanceCount) {
+        mVk.vkResetCommandPool(mDevice, frame.commandPool, 0);
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        mVk.vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+
+        VkClearValue clear = {};
+        clear.color = {{0.3f, 0.3f, 0.3f, 1.0f}};
+        VkRenderPassBeginInfo passInfo = {};
+        passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        passInfo.renderPass = mRenderPass;
+        passInfo.framebuffer = mFramebuffers[imageIndex];
+        passInfo.renderArea = {{0, 0}, mExtent};
+        passInfo.clearValueCount = 1;
+        passInfo.pClearValues = &clear;
+        mVk.vkCmdBeginRenderPass(frame.commandBuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        // Flipped so clip space points up like in GLES and the shaders are shared unchanged
+        auto width = static_cast<float>(mExtent.width);
+        auto height = static_cast<float>(mExtent.height);
+        VkViewport viewport = {0.0f, height, width, -height, 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, mExtent};
+        mVk.vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+        mVk.vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
+        mVk.vkCmdSetScissor(frame.commandBuffer, 0, 1, &scissor);
+        mVk.vkCmdPushConstants(frame.commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                               0, sizeof(FrameUniforms), &mFrameUniforms);
+        mVk.vkCmdPushConstants(frame.commandBuffer, mPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+                               sizeof(FrameUniforms), sizeof(BatchUniforms), &kDefaultBatchUniforms);
+
+        const VkBuffer buffers[] = {mVertexBuffer, frame.instanceBuffer};
+        const VkDeviceSize offsets[] = {0, 0};
+        mVk.vkCmdBindVertexBuffers(frame.commandBuffer, 0, 2, buffers, offsets);
+        if (instanceCount > 0) {
+            mVk.vkCmdDraw(frame.commandBuffer, 3, instanceCount, 0, 0);
+        }
+
+        mVk.vkCmdEndRenderPass(frame.commandBuffer);
+        mVk.vkEndCommandBuffer(frame.commandBuffer);
+    }
+
+    void drawFrame() override {
+        if (mSwapchainDirty && !recreateSwapchain()) {
+            return;
+        }
+
+        // Only blocks when the GPU is still on the frame that last used this slot
+        Frame& frame = mFrames[mFrameIndex];
+        if ((frame.fence == VK_NULL_HANDLE && !createSignalledFence(frame.fence)) ||
+            (frame.imageAcquired == VK_NULL_HANDLE && !createSemaphore(frame.imageAcquired))) {
+            return;
+        }
+        mVk.vkWaitForFences(mDevice, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+
+        uint32_t imageIndex = 0;
+        VkResult result = mVk.vkAcquireNextImageKHR(mDevice, mSwapchain, UINT64_MAX, frame.imageAcquired,
+                                                    VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            mSwapchainDirty = true;
+            return;
+        }
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            LOG_ERROR("Failed to acquire a swapchain image (%d)", result);
+            return;
+        }
+        // Reset only once a submit is certain to follow, or the next wait would never return
+        mVk.vkResetFences(mDevice, 1, &frame.fence);
+
+        latchInput();
+        recordCommands(frame, imageIndex, writeInstances(frame));
+
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &frame.imageAcquired;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &frame.commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &mRenderFinished[imageIndex];
+        if (mVk.vkQueueSubmit(mQueue, 1, &submitInfo, frame.fence) != VK_SUCCESS) {
+            LOG_ERROR("Failed to submit the frame");
+            // Nothing will signal the reset fence now, so swap in a signalled one for the next wait.
+            // Nothing waits on the acquire's semaphore either, and acquiring into it again while
+            // it is signalled is invalid, so it is replaced too.
+            mVk.vkDeviceWaitIdle(mDevice);
+            mVk.vkDestroyFence(mDevice, frame.fence, nullptr);
+            createSignalledFence(frame.fence);
+            mVk.vkDestroySemaphore(mDevice, frame.imageAcquired, nullptr);
+            createSemaphore(frame.imageAcquired);
+            // The acquired image is never presented, so it only comes back with a new swapchain
+            mSwapchainDirty = true;
+            return;
+        }
+
+        endFrameWork();
+        mFramePacer.beforePresent();
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &mRenderFinished[imageIndex];
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &mSwapchain;
+        presentInfo.pImageIndices = &imageIndex;
+        result = mVk.vkQueuePresentKHR(mQueue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            mSwapchainDirty = true;
+        } else if (result == VK_ERROR_SURFACE_LOST_KHR) {
+            LOG_ERROR("Vulkan surface lost");
+            detachWindow();
+        }
+        mFrameIndex = (mFrameIndex + 1) % kFramesInFlight;
+    }
+
+    void cleanup() override {
+        detachWindow();
+        destroyDevice();
+        if (mInstance != VK_NULL_HANDLE) {
+            mVk.vkDestroyInstance(mInstance, nullptr);
+            mInstance = VK_NULL_HANDLE;
+        }
+        LOG_INFO("Renderer cleaned up");
+    }
+
+    [[nodiscard]]
+    bool isReadyToDraw() const override {
+        return mSwapchain != VK_NULL_HANDLE;
+    }
+
+    void onRenderThreadStarted() override {
+        if (mHudEnabled) {
+            LOG_INFO("The frame time HUD is only drawn by the GLES renderer");
+        }
+        if (mMinResolutionScale < 1.0f || mMaxResolutionScale < 1.0f) {
+            LOG_INFO("Dynamic resolution unsupported on Vulkan, drawing at full resolution");
+        }
+        if (mGpuCulling) {
+            LOG_INFO("GPU culling unsupported on Vulkan, using CPU path");
+        }
+    }
+
+public:
+    VulkanRenderer(android_app* app, JobSystem& jobs) : Renderer(app, jobs) {
+        mSceneInstances.push_back({{}, {0.0f, 1.0f, 0.0f, 1.0f}});
+        mSceneTransforms.push({0.0f, 0.0f, 0.0f}, Quat{}, 1.0f);
+        mSceneBounds.push(0.0f, 0.0f, 0.0f, 0.71f);
+        mVisible.resize(mSceneInstances.size());
+        mStagedInstances.resize(mSceneInstances.size());
+        // No camera yet, so the view volume is clip space itself until a drag pans it
+        mInputEnabled = true;
+        mCuller.setViewProjection(Mat4::identity().m);
+    }
+
+    ~VulkanRenderer() {
+        stop();
+    }
+
+    // Whether the loader and at least one device speak Vulkan 1.1; present support is
+    // only known once there is a window, so the device itself is picked later
+    static bool isSupported() {
+        VulkanFunctions vk;
+        VkInstance instance = VK_NULL_HANDLE;
+        if (!createInstance(vk, instance)) {
+            return false;
+        }
+        bool supported = false;
+        for (VkPhysicalDevice device : physicalDevices(vk, instance)) {
+            VkPhysicalDeviceProperties properties;
+            vk.vkGetPhysicalDeviceProperties(device, &properties);
+            supported = supported || properties.apiVersion >= VK_API_VERSION_1_1;
+        }
+        vk.vkDestroyInstance(instance, nullptr);
+        return supported;
+    }
+};
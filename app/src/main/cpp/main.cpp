@@ -1,264 +1,576 @@
 #include <android_native_app_glue.h>
 #include <EGL/egl.h>
 #include <GLES3/gl3.h>
-#include <android/log.h>
+#include <pthread.h>
+#include <sys/system_properties.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <thread>
+
+#include "AssetLoader.h"
+#include "Benchmark.h"
+#include "CommandBuffer.h"
+#include "DynamicResolution.h"
+#include "EGLConfigChooser.h"
+#include "FrameAllocator.h"
+#include "FramePacer.h"
+#include "FrustumCuller.h"
+#include "FrameProfiler.h"
+#include "GLStateCache.h"
+#include "GpuCuller.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MeshAsset.h"
+#include "PoolAllocator.h"
+#include "ProgramCache.h"
+#include "RenderPass.h"
+#include "RenderQueue.h"
+#include "Renderer.h"
+#include "ShaderProgram.h"
+#include "ShaderVariants.h"
+#include "SimdMath.h"
+#include "SpscQueue.h"
+#include "SurfaceDamage.h"
+#include "Texture.h"
+#include "TriangleMesh.h"
+#ifdef NATIVEAPP_VULKAN
+#include "VulkanRenderer.h"
+#endif
 
-#define LOG_TAG "RealNativeApp"
-#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-
-// Shader source code
-namespace Shaders {
-    // Vertex shader source
-    constexpr char vertexShaderSource[] = R"(#version 320 es
-    layout(location = 0) in vec3 aPos;
-    void main() {
-        gl_Position = vec4(aPos, 1.0);
-    })";
-
-    // Fragment shader source
-    constexpr char fragmentShaderSource[] = R"(#version 320 es
-    precision mediump float;
-    out vec4 FragColor;
-    void main() {
-        FragColor = vec4(0.0, 1.0, 0.0, 1.0);
-    })";
-}
-
-// Shader utility class
-class ShaderProgram {
+// EGL renderer class
+// The GLES backend: the EGL context is current on the render thread, which everything
+// below the public section runs on. The display, context and GPU resources outlive the
+// window surface, so only the surface is recreated when the activity goes to the
+// background and comes back.
+class EGLRenderer : public Renderer {
 private:
-    GLuint mProgramId = 0;
+    static constexpr uint32_t kMaxDrawsPerFrame = 16384;
+    static constexpr size_t kMaxRecordingThreads = 8;
+    static constexpr uint32_t kObjectsPerRecordJob = 256;
+    static constexpr size_t kFrameArenaBytes = 4 * 1024 * 1024;
+    static constexpr size_t kMaxMeshes = 64;
+    static constexpr char kSceneMeshPath[] = "meshes/scene.mesh";
+    static constexpr char kSceneTexturePath[] = "textures/scene";  // .astc.ktx2 or .etc2.ktx2
+    static constexpr float kSceneMeshRadius = 0.5f;                 // In clip space
+    static constexpr float kThermalScaleCap = 0.75f;                // Resolution cap once warm
+    // Nothing draws with depth or stencil yet; raising these adds them to the window pass
+    static constexpr EGLint kDepthBits = 0;
+    static constexpr EGLint kStencilBits = 0;
+    static constexpr EGLint kSamples = 0;  // The driver resolves a multisampled window at swap
+
+    struct SceneObject {
+        RenderQueue::Handle program;
+        RenderQueue::Handle mesh;
+        RenderQueue::Handle material;
+        float depth;
+        float color[4];
+        TriangleMesh* geometry;  // The mesh behind the handle, for GPU culling
+        // Drawn instead while mSceneTextured is set, kInvalidHandle for objects without one
+        RenderQueue::Handle texturedProgram;
+        RenderQueue::Handle texturedMaterial;
+    };
+
+    // Records one job's share of the scene into its own command buffer
+    struct RecordJob {
+        EGLRenderer* renderer;
+        uint32_t objectsPerJob;
+
+        void operator()(uint32_t begin, uint32_t end) const {
+            renderer->recordObjects(begin / objectsPerJob, begin, end);
+        }
+    };
+
+    FrameProfiler mProfiler;
+    DynamicResolution mResolution;
+    RenderPass mWindowPass;
+    SurfaceDamage mSurfaceDamage;
+    ProgramCache mProgramCache;
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLConfig mConfig = nullptr;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    ShaderVariantSet mShaderVariants;
+    TriangleMesh mTriangle;
+    PoolAllocator<TriangleMesh> mMeshPool{kMaxMeshes};
+    MeshAsset mSceneAsset;
+    AssetLoader mLoader;
+    TriangleMesh* mSceneMesh = nullptr;  // From mMeshPool, when the APK ships kSceneMeshPath
+    StreamedTexture mSceneTexture;
+    RenderQueue mRenderQueue;
+    GpuCuller mGpuCuller;
+    CommandRecorder mRecorder{kMaxRecordingThreads};
+    FrameAllocator mFrameAllocator;
+    std::vector<SceneObject> mScene;
+    TransformSoA mSceneTransforms;
+    BoundsSoA mSceneBounds;
+    RecordJob mRecordJob{this, kObjectsPerRecordJob};
+    JobCounter mRecordCounter;
+    RenderQueue::Handle mProgramHandle = 0;
+    RenderQueue::Handle mTriangleHandle = 0;
+    RenderQueue::Handle mMaterialHandle = 0;
+    // For the scene mesh, when it has texture coordinates
+    RenderQueue::Handle mTexturedProgramHandle = RenderQueue::kInvalidHandle;
+    RenderQueue::Handle mTexturedMaterialHandle = RenderQueue::kInvalidHandle;
+    // Whether the scene texture can be sampled; only changes while no recording job runs
+    bool mSceneTextured = false;
+    bool mResourcesReady = false;
+    Benchmark mBenchmark;
+    EGLSurface mBenchmarkSurface = EGL_NO_SURFACE;
+    bool mBenchmarking = false;  // The context is the benchmark's until it finishes the activity
+    EGLint mWidth = 0;
+    EGLint mHeight = 0;
+    // Touch drags pan the scene; clip space offset as of the last latch
+    float mPanX = 0.0f;
+    float mPanY = 0.0f;
+    bool mPanMoving = false;
+    
+    bool initializeDisplay(EGLint surfaceType) {
+        // Initialize EGL
+        mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (mDisplay == EGL_NO_DISPLAY) {
+            LOG_ERROR("Failed to get EGL display");
+            return false;
+        }
+
+        if (!eglInitialize(mDisplay, nullptr, nullptr)) {
+            LOG_ERROR("Failed to initialize EGL");
+            mDisplay = EGL_NO_DISPLAY;
+            return false;
+        }
 
-    static GLuint compileShader(GLenum type, const char* source) {
-        GLuint shader = glCreateShader(type);
-        glShaderSource(shader, 1, &source, nullptr);
-        glCompileShader(shader);
+        // Configure EGL with just the buffers the window pass uses
+        EGLConfigRequest request;
+        request.surfaceType = surfaceType;
+        if (mColorFormat == ColorFormat::Rgb565) {
+            request.redSize = 5;
+            request.greenSize = 6;
+            request.blueSize = 5;
+        }
+        request.depthSize = kDepthBits;
+        request.stencilSize = kStencilBits;
+        request.samples = kSamples;
+        if (!chooseEGLConfig(mDisplay, request, mConfig)) {
+            LOG_ERROR("Failed to choose EGL config");
+            eglTerminate(mDisplay);
+            mDisplay = EGL_NO_DISPLAY;
+            return false;
+        }
 
-        GLint success;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char infoLog[512];
-            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-            LOG_ERROR("Shader compilation error: %s", infoLog);
-            glDeleteShader(shader);
-            return 0;
+        // A config with extra buffers only means more attachments for the window pass to invalidate
+        EGLint depth = eglConfigAttrib(mDisplay, mConfig, EGL_DEPTH_SIZE);
+        EGLint stencil = eglConfigAttrib(mDisplay, mConfig, EGL_STENCIL_SIZE);
+        mWindowPass.setFramebuffer(0, RenderPass::kColor | (depth > 0 ? RenderPass::kDepth : 0) |
+                                      (stencil > 0 ? RenderPass::kStencil : 0));
+        LOG_INFO("EGL config R%dG%dB%dA%d, depth %d, stencil %d, %d samples",
+                 eglConfigAttrib(mDisplay, mConfig, EGL_RED_SIZE), eglConfigAttrib(mDisplay, mConfig, EGL_GREEN_SIZE),
+                 eglConfigAttrib(mDisplay, mConfig, EGL_BLUE_SIZE), eglConfigAttrib(mDisplay, mConfig, EGL_ALPHA_SIZE),
+                 depth, stencil, eglConfigAttrib(mDisplay, mConfig, EGL_SAMPLES));
+        return true;
+    }
+
+    bool createContext() {
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+        mContext = eglCreateContext(mDisplay, mConfig, EGL_NO_CONTEXT, contextAttribs);
+        if (mContext == EGL_NO_CONTEXT) {
+            LOG_ERROR("Failed to create EGL context");
+            return false;
         }
-        return shader;
+        return true;
     }
 
-public:
-    ShaderProgram() = default;
-    ~ShaderProgram() {
-        if (mProgramId) {
-            glDeleteProgram(mProgramId);
+    // GPU objects die with the context, so only their names need to be dropped
+    void destroyContext() {
+        // Its context shares objects with mContext, so it goes first
+        mLoader.stop();
+        mSceneTexture.invalidate();
+        mShaderVariants.invalidate();
+        mTriangle.invalidate();
+        if (mSceneMesh) {
+            mSceneMesh->invalidate();
+        }
+        mRenderQueue.invalidate();
+        mGpuCuller.invalidate();
+        mProfiler.invalidate();
+        mResolution.invalidate();
+        mResourcesReady = false;
+
+        if (mContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(mDisplay, mContext);
+            mContext = EGL_NO_CONTEXT;
         }
     }
 
-    bool initialize(const char* vertexSource, const char* fragmentSource) {
-        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    bool initializeResources() {
+        // Variants build when first drawn, except the ones the scene uses, prewarmed below
+        mProgramCache.initialize(mApp->activity->internalDataPath);
+        bool parallel = ShaderProgram::enableParallelCompile();
+        mShaderVariants.initialize(&mProgramCache, parallel);
 
-        if (!vertexShader || !fragmentShader) {
+        // Create triangle mesh
+        if (!mTriangle.initialize() || !mTriangle.enableInstancing(1)) {
+            LOG_ERROR("Failed to initialize triangle mesh");
             return false;
         }
 
-        mProgramId = glCreateProgram();
-        glAttachShader(mProgramId, vertexShader);
-        glAttachShader(mProgramId, fragmentShader);
-        glLinkProgram(mProgramId);
+        if (mSceneMesh) {
+            loadSceneMesh();
+        }
 
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        // Which file is opened depends on the GPU, so this waits for the first context
+        if (mSceneTexture.isOpen() || mSceneTexture.open(mApp->activity->assetManager, kSceneTexturePath)) {
+            startLoader();
+            mSceneTexture.load(mLoader);
+        }
+        // These start up front and are only waited on when first drawn
+        bool sceneTextured = mTexturedProgramHandle != RenderQueue::kInvalidHandle && mSceneTexture.isOpen();
+        const uint32_t variants[] = {ShaderFeature::kInstanced, ShaderFeature::kInstanced | ShaderFeature::kTextured};
+        mShaderVariants.prewarm(variants, sceneTextured ? 2 : 1);
 
-        GLint success;
-        glGetProgramiv(mProgramId, GL_LINK_STATUS, &success);
-        if (!success) {
-            char infoLog[512];
-            glGetProgramInfoLog(mProgramId, 512, nullptr, infoLog);
-            LOG_ERROR("Program link error: %s", infoLog);
-            glDeleteProgram(mProgramId);
-            mProgramId = 0;
+        if (!mRenderQueue.initialize(kMaxDrawsPerFrame)) {
+            LOG_ERROR("Failed to initialize render queue");
             return false;
         }
+        if (mGpuCulling && !initializeGpuCulling()) {
+            LOG_ERROR("GPU culling unavailable, recording the scene on the workers");
+            mGpuCulling = false;
+        }
+
+        mProfiler.initialize();
 
+        LOG_INFO("GPU resources initialized");
         return true;
     }
 
-    void use() const {
-        glUseProgram(mProgramId);
+    // Render thread, with no recording job in flight. The scene mesh samples the scene
+    // texture once it exists, and draws in its instance colour alone if it failed to load.
+    void updateSceneTextured() {
+        mSceneTextured = mSceneTexture.isOpen() && !mSceneTexture.hasFailed();
     }
-};
 
-// Triangle mesh class
-class TriangleMesh {
-private:
-    GLuint mVAO = 0;
-    GLuint mVBO = 0;
-    
-    // Vertex data for triangle
-    static constexpr float vertices[] = {
-         0.0f,  0.5f, 0.0f,  // top
-        -0.5f, -0.5f, 0.0f,  // left
-         0.5f, -0.5f, 0.0f   // right
-    };
-
-public:
-    TriangleMesh() = default;
-    ~TriangleMesh() {
-        cleanup();
+    // The scene never moves, so its objects are uploaded once and only culled per frame
+    bool initializeGpuCulling() {
+        std::vector<TriangleMesh*> meshes;
+        std::vector<InstanceData> instances(mScene.size());
+        std::vector<GpuCuller::Object> objects(mScene.size());
+        auto count = static_cast<uint32_t>(mScene.size());
+        composeTransforms(mSceneTransforms, 0, count, instances[0].transform, sizeof(InstanceData) / sizeof(float));
+        for (uint32_t i = 0; i < count; ++i) {
+            const SceneObject& object = mScene[i];
+            auto mesh = std::find(meshes.begin(), meshes.end(), object.geometry);
+            if (mesh == meshes.end()) {
+                mesh = meshes.insert(meshes.end(), object.geometry);
+            }
+            std::copy(std::begin(object.color), std::end(object.color), instances[i].color);
+            objects[i] = {{mSceneBounds.x[i], mSceneBounds.y[i], mSceneBounds.z[i], mSceneBounds.radius[i]},
+                          instances[i], static_cast<uint32_t>(mesh - meshes.begin()), 0, {}};
+        }
+        return mGpuCuller.initialize(meshes, std::move(objects));
     }
 
-    bool initialize() {
-        glGenVertexArrays(1, &mVAO);
-        glGenBuffers(1, &mVBO);
-
-        glBindVertexArray(mVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
-        glBindVertexArray(0);
-        
-        return (mVAO != 0 && mVBO != 0);
+    bool startLoader() {
+        return mLoader.isRunning() || mLoader.start(mDisplay, mConfig, mContext);
     }
 
-    void draw() const {
-        glBindVertexArray(mVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
-    }
+    // Uploads straight from the mapped asset on the loader thread; the mesh is skipped
+    // by the render queue until the upload has finished on the GPU
+    void loadSceneMesh() {
+        const AssetLoader::Request request = {
+            [](void* context) {
+                auto* renderer = static_cast<EGLRenderer*>(context);
+                return renderer->mSceneAsset.upload(*renderer->mSceneMesh);
+            },
+            [](void* context, bool ok) {
+                auto* renderer = static_cast<EGLRenderer*>(context);
+                if (!ok || !renderer->mSceneMesh->createVertexArray() || !renderer->mSceneMesh->enableInstancing(1)) {
+                    LOG_ERROR("Failed to upload %s", kSceneMeshPath);
+                }
+            },
+            this,
+        };
 
-    void cleanup() {
-        if (mVBO) {
-            glDeleteBuffers(1, &mVBO);
-            mVBO = 0;
-        }
-        
-        if (mVAO) {
-            glDeleteVertexArrays(1, &mVAO);
-            mVAO = 0;
+        if (startLoader() && mLoader.submit(request)) {
+            return;
         }
+        // No loader context, so take the hit on this thread instead
+        request.complete(this, request.upload(this));
     }
-};
 
-// EGL renderer class
-class EGLRenderer {
-private:
-    android_app* mApp = nullptr;
-    EGLDisplay mDisplay = EGL_NO_DISPLAY;
-    EGLSurface mSurface = EGL_NO_SURFACE;
-    EGLContext mContext = EGL_NO_CONTEXT;
-    ShaderProgram mShaderProgram;
-    TriangleMesh mTriangle;
-    
-public:
-    explicit EGLRenderer(android_app* app) : mApp(app) {}
-    
-    ~EGLRenderer() {
-        cleanup();
-    }
-    
-    bool initialize() {
-        // Initialize EGL
-        mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-        if (mDisplay == EGL_NO_DISPLAY) {
-            LOG_ERROR("Failed to get EGL display");
-            return false;
+    // Binds the surface to the context, rebuilding the context only if the driver lost it
+    bool makeCurrent() {
+        if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+            if (eglGetError() != EGL_CONTEXT_LOST) {
+                LOG_ERROR("Failed to make EGL current");
+                return false;
+            }
+
+            LOG_INFO("EGL context lost, recreating it");
+            destroyContext();
+            if (!createContext() || !eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+                LOG_ERROR("Failed to make EGL current");
+                return false;
+            }
         }
 
-        if (!eglInitialize(mDisplay, nullptr, nullptr)) {
-            LOG_ERROR("Failed to initialize EGL");
-            return false;
+        // Nothing is known about the state of a context that was just made current
+        GLStateCache::current().reset();
+
+        if (!mResourcesReady) {
+            // Recording jobs read the scene this sets up
+            mJobs.wait(mRecordCounter);
+            mResourcesReady = initializeResources();
         }
+        return mResourcesReady;
+    }
 
-        // Configure EGL
-        const EGLint configAttribs[] = {
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-            EGL_BLUE_SIZE, 8,
-            EGL_GREEN_SIZE, 8,
-            EGL_RED_SIZE, 8,
-            EGL_NONE
-        };
+    bool attachWindow(ANativeWindow* window) override {
+        if (mBenchmarking) {
+            LOG_INFO("Benchmark running, ignoring the window");
+            return true;
+        }
 
-        EGLConfig config;
-        EGLint numConfigs;
-        if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
-            LOG_ERROR("Failed to choose EGL config");
+        // Pbuffer support is for the asset loader's context
+        if (mDisplay == EGL_NO_DISPLAY && !initializeDisplay(EGL_WINDOW_BIT | EGL_PBUFFER_BIT)) {
             return false;
         }
 
         // Create surface
-        mSurface = eglCreateWindowSurface(mDisplay, config, mApp->window, nullptr);
+        mSurface = eglCreateWindowSurface(mDisplay, mConfig, window, nullptr);
         if (mSurface == EGL_NO_SURFACE) {
             LOG_ERROR("Failed to create EGL surface");
             return false;
         }
 
-        // Create context
-        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
-        mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttribs);
-        if (mContext == EGL_NO_CONTEXT) {
-            LOG_ERROR("Failed to create EGL context");
+        if (mContext == EGL_NO_CONTEXT && !createContext()) {
             return false;
         }
 
-        if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
-            LOG_ERROR("Failed to make EGL current");
+        if (!makeCurrent()) {
             return false;
         }
 
-        // Create shader program
-        if (!mShaderProgram.initialize(Shaders::vertexShaderSource, Shaders::fragmentShaderSource)) {
-            LOG_ERROR("Failed to create shader program");
-            return false;
+        mFramePacer.attachSurface(mDisplay);
+        mSurfaceDamage.attachSurface(mDisplay);
+        resize();
+
+        LOG_INFO("Window surface attached");
+        return true;
+    }
+
+    // Drops only the window surface; the context and everything in it stay alive
+    void detachWindow() override {
+        if (mDisplay == EGL_NO_DISPLAY || mBenchmarking) {
+            return;
         }
 
-        // Create triangle mesh
-        if (!mTriangle.initialize()) {
-            LOG_ERROR("Failed to initialize triangle mesh");
-            return false;
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (mSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(mDisplay, mSurface);
+            mSurface = EGL_NO_SURFACE;
+            LOG_INFO("EGL surface destroyed");
         }
+    }
 
-        LOG_INFO("Renderer initialized successfully");
-        return true;
+    void resize() override {
+        eglQuerySurface(mDisplay, mSurface, EGL_WIDTH, &mWidth);
+        eglQuerySurface(mDisplay, mSurface, EGL_HEIGHT, &mHeight);
+        GLStateCache::current().viewport(0, 0, mWidth, mHeight);
+        mResolution.resize(mWidth, mHeight);
+        mSurfaceDamage.resize(mWidth, mHeight);
     }
     
-    void drawFrame() {
-        if (mDisplay == EGL_NO_DISPLAY) {
+    void recordObjects(size_t bufferIndex, uint32_t begin, uint32_t end) {
+        CommandBuffer& commands = mRecorder.buffer(bufferIndex);
+        uint32_t* visible = mFrameAllocator.allocate<uint32_t>(end - begin);
+        InstanceData* instances = mFrameAllocator.allocate<InstanceData>(end - begin);
+        uint32_t visibleCount = 0;
+        if (visible && instances) {
+            // Culled first, so only the objects that are drawn pay for a matrix
+            visibleCount = mCuller.cull(mSceneBounds, begin, end, visible);
+            composeIndexedTransforms(mSceneTransforms, visible, visibleCount, instances[0].transform,
+                                     sizeof(InstanceData) / sizeof(float));
+        }
+
+        commands.begin(mFrameAllocator, visibleCount);
+        for (uint32_t i = 0; i < visibleCount; ++i) {
+            const SceneObject& object = mScene[visible[i]];
+            InstanceData& instance = instances[i];
+            std::copy(std::begin(object.color), std::end(object.color), instance.color);
+            if (mSceneTextured && object.texturedProgram != RenderQueue::kInvalidHandle) {
+                commands.draw(object.texturedProgram, object.mesh, object.texturedMaterial, object.depth, instance);
+            } else {
+                commands.draw(object.program, object.mesh, object.material, object.depth, instance);
+            }
+        }
+        commands.end();
+    }
+
+    // Scene preparation only records commands, so it runs on the workers
+    void kickRecording() {
+        auto count = static_cast<uint32_t>(mScene.size());
+        uint32_t perJob = std::max<uint32_t>(kObjectsPerRecordJob,
+                                             (count + kMaxRecordingThreads - 1) / kMaxRecordingThreads);
+        mRecordJob.objectsPerJob = perJob;
+        mFrameAllocator.beginFrame();
+        mRecorder.beginFrame((count + perJob - 1) / perJob);
+        mJobs.parallelFor(count, perJob, mRecordCounter, mRecordJob);
+    }
+
+    // Takes the samples that arrived since the last frame; a pan that moves repaints everything
+    void updateInput() {
+        mInput.update();
+        float panX = 0.0f;
+        float panY = 0.0f;
+        mInput.panOffset(nowNanos() + mFramePacer.framePeriodNs(), static_cast<float>(mWidth),
+                         static_cast<float>(mHeight), panX, panY);
+        mPanMoving = mInput.isTouching() || panX != mPanX || panY != mPanY;
+    }
+
+    // Called as late as the frame allows, right before its draws are submitted, so they use
+    // the newest sample instead of one from the start of the frame. Only while the pan moves,
+    // since the damage for a still frame has already been worked out from the old pan.
+    void latchInput() {
+        if (mPanMoving) {
+            mInput.update();
+            int64_t now = nowNanos();
+            mInput.panOffset(now + mFramePacer.framePeriodNs(), static_cast<float>(mWidth),
+                             static_cast<float>(mHeight), mPanX, mPanY);
+            if (mInput.isTouching()) {
+                mProfiler.addInputLatency(now - mInput.latestTimeNs());
+            }
+        }
+        Mat4 viewProjection = Mat4::translation({mPanX, mPanY, 0.0f});
+        mRenderQueue.setViewProjection(viewProjection.m);
+        mGpuCuller.setViewProjection(viewProjection.m);
+        // The workers are idle here, and record the next frame with this pan
+        mCuller.setViewProjection(viewProjection.m);
+    }
+
+    // Only the scene objects and the HUD ever change, the background around them never does.
+    // The upscale from dynamic resolution and a moving pan cover the whole window.
+    void addFrameDamage() {
+        if (mResolution.isEnabled() || mPanMoving) {
+            mSurfaceDamage.damageAll();
             return;
         }
-        
-        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        // Bounds are spheres in clip space, and the view-projection only pans
+        const float halfWidth = 0.5f * static_cast<float>(mWidth);
+        const float halfHeight = 0.5f * static_cast<float>(mHeight);
+        DamageRect scene;
+        for (size_t i = 0; i < mSceneBounds.size(); ++i) {
+            float radius = mSceneBounds.radius[i];
+            float x = mSceneBounds.x[i] + mPanX;
+            float y = mSceneBounds.y[i] + mPanY;
+            auto left = static_cast<int32_t>(std::floor((x - radius + 1.0f) * halfWidth));
+            auto bottom = static_cast<int32_t>(std::floor((y - radius + 1.0f) * halfHeight));
+            auto right = static_cast<int32_t>(std::ceil((x + radius + 1.0f) * halfWidth));
+            auto top = static_cast<int32_t>(std::ceil((y + radius + 1.0f) * halfHeight));
+            scene.unite({left, bottom, right - left, top - bottom});
+        }
+        mSurfaceDamage.addDamage(scene);
+        if (mHudEnabled) {
+            mSurfaceDamage.addDamage(mProfiler.hudRect(mWidth, mHeight));
+        }
+    }
 
-        mShaderProgram.use();
-        mTriangle.draw();
+    void drawFrame() override {
+        mLoader.poll();
+        // The scene texture only needs the detail the scene mesh covers on screen
+        auto sceneSize = kSceneMeshRadius * static_cast<float>(std::max(mWidth, mHeight));
+        mSceneTexture.requestSize(static_cast<GLsizei>(sceneSize));
+        mSceneTexture.update(mLoader);
+        mProfiler.setTargetPeriod(mFramePacer.framePeriodNs());
+        FrameAllocator::Stats arena = mFrameAllocator.stats();
+        mProfiler.setArenaUsage(arena.highWater, arena.capacity, arena.failures);
+        mProfiler.setPoolUsage(mMeshPool.live(), mMeshPool.highWater(), mMeshPool.capacity());
+        mProfiler.beginFrame();
+
+        // Each GPU result nudges the scene resolution towards the frame budget
+        int64_t gpuTimeNs = 0;
+        if (mProfiler.takeLatestGpuTime(gpuTimeNs)) {
+            mResolution.update(gpuTimeNs, mFramePacer.framePeriodNs());
+        }
+        updateInput();
+
+        // A dispatch inside the window pass would flush its tiles, so culling comes first
+        if (mGpuCulling) {
+            mGpuCuller.cull();
+        }
 
-        eglSwapBuffers(mDisplay, mSurface);
+        mProfiler.beginPhase(FrameProfiler::Phase::Clear);
+        addFrameDamage();
+        DamageRect repaint = mSurfaceDamage.beginFrame(mDisplay, mSurface);
+        mWindowPass.setRenderArea(repaint.x, repaint.y, repaint.width, repaint.height);
+        mWindowPass.begin();
+        mResolution.beginScene();
+        mProfiler.endPhase(FrameProfiler::Phase::Clear);
+
+        // Programs still compiling are skipped, so the first frames show up before all are ready
+        mProfiler.beginPhase(FrameProfiler::Phase::Draw);
+        if (mGpuCulling) {
+            // Culled with the previous latch, which a drag only moves by a sample or two
+            latchInput();
+            mGpuCuller.draw(*mShaderVariants.program(ShaderFeature::kInstanced));
+        } else {
+            if (mRecorder.bufferCount() == 0) {
+                kickRecording();
+            }
+            mJobs.wait(mRecordCounter);
+            mRecorder.replay(mRenderQueue);
+            latchInput();
+            updateSceneTextured();
+            // The next frame records while this one is submitted and swapped
+            kickRecording();
+            mRenderQueue.flush();
+        }
+        mResolution.endScene();
+        mProfiler.endPhase(FrameProfiler::Phase::Draw);
+
+        if (mHudEnabled) {
+            mProfiler.beginPhase(FrameProfiler::Phase::Hud);
+            mProfiler.drawHud(mWidth, mHeight);
+            mProfiler.endPhase(FrameProfiler::Phase::Hud);
+        }
+        mWindowPass.end();
+        mProfiler.endGpuWork();
+
+        mProfiler.beginPhase(FrameProfiler::Phase::Swap);
+        endFrameWork();
+        mFramePacer.beforeSwap(mDisplay, mSurface);
+        bool swapped = mSurfaceDamage.swapBuffers(mDisplay, mSurface);
+        mProfiler.endPhase(FrameProfiler::Phase::Swap);
+        mProfiler.endFrame();
+
+        if (!swapped) {
+            EGLint error = eglGetError();
+            if (error == EGL_CONTEXT_LOST) {
+                LOG_INFO("EGL context lost, recreating it");
+                destroyContext();
+                if (!createContext() || !makeCurrent()) {
+                    detachWindow();
+                } else {
+                    resize();
+                }
+            } else if (error == EGL_BAD_SURFACE || error == EGL_BAD_NATIVE_WINDOW) {
+                LOG_ERROR("EGL surface became invalid (0x%x)", error);
+                detachWindow();
+            }
+        }
     }
     
-    void cleanup() {
-        // Cleanup mesh resources
-        mTriangle.cleanup();
-        
+    void cleanup() override {
+        // Recording jobs still in flight refer to this renderer
+        mJobs.wait(mRecordCounter);
+
         // Cleanup EGL
         if (mDisplay != EGL_NO_DISPLAY) {
-            eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-            
-            if (mContext != EGL_NO_CONTEXT) {
-                eglDestroyContext(mDisplay, mContext);
-                mContext = EGL_NO_CONTEXT;
-            }
-            
-            if (mSurface != EGL_NO_SURFACE) {
-                eglDestroySurface(mDisplay, mSurface);
-                mSurface = EGL_NO_SURFACE;
-            }
-            
+            stopBenchmark();
+            detachWindow();
+            destroyContext();
             eglTerminate(mDisplay);
             mDisplay = EGL_NO_DISPLAY;
         }
@@ -267,63 +579,287 @@ public:
     }
 
     [[nodiscard]]
-    bool isInitialized() const {
-        return mDisplay != EGL_NO_DISPLAY;
+    bool isReadyToDraw() const override {
+        return mSurface != EGL_NO_SURFACE && mResourcesReady;
+    }
+
+    // Sets the benchmark up against a pbuffer; runBackgroundStep() then runs it a scene at
+    // a time. The config also supports windows so the context stays usable afterwards.
+    void startBenchmark() {
+        if (!mApp->activity->internalDataPath || !initializeDisplay(EGL_WINDOW_BIT | EGL_PBUFFER_BIT)) {
+            return;
+        }
+
+        // Only the benchmark's own objects are needed, so the scene resources stay unloaded
+        const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        mBenchmarkSurface = eglCreatePbufferSurface(mDisplay, mConfig, pbufferAttribs);
+        if (mBenchmarkSurface == EGL_NO_SURFACE || !createContext() ||
+            !eglMakeCurrent(mDisplay, mBenchmarkSurface, mBenchmarkSurface, mContext)) {
+            LOG_ERROR("Failed to set up benchmark context");
+            stopBenchmark();
+            return;
+        }
+        GLStateCache::current().reset();
+        eglSwapInterval(mDisplay, 0);
+
+        if (!mBenchmark.initialize(1920, 1080, &mProgramCache)) {
+            LOG_ERROR("Benchmark failed");
+            stopBenchmark();
+            return;
+        }
+        std::string outputPath = std::string(mApp->activity->internalDataPath) + "/benchmark.json";
+        mBenchmark.start(mBenchmarkFrames, outputPath.c_str());
+        mBenchmarking = true;
+    }
+
+    void stopBenchmark() {
+        mBenchmark.cleanup();
+        mBenchmarking = false;
+        if (mBenchmarkSurface != EGL_NO_SURFACE) {
+            eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroySurface(mDisplay, mBenchmarkSurface);
+            mBenchmarkSurface = EGL_NO_SURFACE;
+        }
     }
+
+    bool runBackgroundStep() override {
+        if (!mBenchmarking) {
+            return false;
+        }
+        bool ok = mBenchmark.step();
+        if (ok && !mBenchmark.isFinished()) {
+            return true;
+        }
+        if (!ok) {
+            LOG_ERROR("Benchmark failed");
+        }
+        stopBenchmark();
+        ANativeActivity_finish(mApp->activity);
+        return false;
+    }
+
+    // The frame rate is already handled; with dynamic resolution on, its upper end comes down too
+    void onThermalPressureChanged(ThermalMonitor::Pressure pressure) override {
+        mResolution.setScaleCap(pressure == ThermalMonitor::Pressure::None ? 1.0f : kThermalScaleCap);
+    }
+
+    void onRenderThreadStarted() override {
+        if (mMinResolutionScale < 1.0f || mMaxResolutionScale < 1.0f) {
+            mResolution.setLimits(mMinResolutionScale, mMaxResolutionScale);
+        }
+        if (mBenchmarkFrames > 0) {
+            startBenchmark();
+        }
+    }
+
+public:
+    EGLRenderer(android_app* app, JobSystem& jobs) : Renderer(app, jobs) {
+        mProgramHandle = mRenderQueue.addProgram(mShaderVariants.program(ShaderFeature::kInstanced));
+        mTriangleHandle = mRenderQueue.addMesh(&mTriangle);
+        mMaterialHandle = mRenderQueue.addMaterial({});
+        mScene.push_back({mProgramHandle, mTriangleHandle, mMaterialHandle, 0.5f, {0.0f, 1.0f, 0.0f, 1.0f}, &mTriangle,
+                          RenderQueue::kInvalidHandle, RenderQueue::kInvalidHandle});
+        mSceneTransforms.push({0.0f, 0.0f, 0.0f}, Quat{}, 1.0f);
+        mSceneBounds.push(0.0f, 0.0f, 0.0f, 0.71f);
+
+        // An optional packed mesh, scaled to fit in front of the triangle
+        if (mSceneAsset.open(mApp->activity->assetManager, kSceneMeshPath)) {
+            const MeshFileHeader& header = mSceneAsset.header();
+            float scale = header.boundsRadius > 0.0f ? kSceneMeshRadius / header.boundsRadius : 1.0f;
+            Vec3 offset = Vec3{header.boundsCenter[0], header.boundsCenter[1], header.boundsCenter[2]} * -scale;
+            mSceneMesh = mMeshPool.create();
+            if (mSceneAsset.hasAttribute(TriangleMesh::kTexCoordAttribute)) {
+                RenderQueue::Material textured;
+                textured.texture = &mSceneTexture;
+                mTexturedProgramHandle = mRenderQueue.addProgram(
+                        mShaderVariants.program(ShaderFeature::kInstanced | ShaderFeature::kTextured));
+                mTexturedMaterialHandle = mRenderQueue.addMaterial(textured);
+            }
+            mScene.push_back({mProgramHandle, mRenderQueue.addMesh(mSceneMesh), mMaterialHandle, 0.25f,
+                              {0.8f, 0.8f, 0.8f, 1.0f}, mSceneMesh, mTexturedProgramHandle, mTexturedMaterialHandle});
+            mSceneTransforms.push(offset, Quat{}, scale);
+            mSceneBounds.push(0.0f, 0.0f, 0.0f, kSceneMeshRadius);
+        }
+        mWindowPass.setClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+        mResolution.setClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+
+        // No camera yet, so the view volume is clip space itself until a drag pans it
+        mInputEnabled = true;
+        mCuller.setViewProjection(Mat4::identity().m);
+        mGpuCuller.setViewProjection(Mat4::identity().m);
+        mFrameAllocator.initialize(kFrameArenaBytes);
+    }
+    
+    ~EGLRenderer() {
+        stop();
+        mMeshPool.destroy(mSceneMesh);
+    }
+
+    EGLRenderer(const EGLRenderer&) = delete;
+    EGLRenderer& operator=(const EGLRenderer&) = delete;
 };
 
 // Main application class
 class NativeApp {
 private:
     android_app* mApp = nullptr;
-    std::unique_ptr<EGLRenderer> mRenderer;
+    JobSystem mJobs;  // Declared first so it outlives the render thread
+    std::unique_ptr<Renderer> mRenderer;
+    bool mResumed = false;
+    bool mFocused = false;
+    bool mVisible = false;
     
+    // GLES, which has every feature; Vulkan only on request where the device has 1.1, e.g.
+    // adb shell setprop debug.nativeapp.renderer vulkan to compare. The benchmark scenes are GLES only
+    static std::unique_ptr<Renderer> createRenderer(android_app* app, JobSystem& jobs, bool benchmark) {
+        char backend[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.renderer", backend);
+        if (!benchmark && strcmp(backend, "vulkan") == 0) {
+#ifdef NATIVEAPP_VULKAN
+            if (VulkanRenderer::isSupported()) {
+                LOG_INFO("Rendering with Vulkan");
+                return std::make_unique<VulkanRenderer>(app, jobs);
+            }
+#else
+            LOG_INFO("Built without the Vulkan renderer");
+#endif
+        }
+        LOG_INFO("Rendering with GLES");
+        return std::make_unique<EGLRenderer>(app, jobs);
+    }
+
     static void handleAppCommand(android_app* app, int32_t cmd) {
         auto* nativeApp = static_cast<NativeApp*>(app->userData);
         nativeApp->onAppCmd(cmd);
+        nativeApp->updateVisibility();
+    }
+
+    static int32_t handleInputEvent(android_app* app, AInputEvent* event) {
+        auto* nativeApp = static_cast<NativeApp*>(app->userData);
+        return nativeApp->mRenderer->onInputEvent(event);
     }
     
     void onAppCmd(int32_t cmd) {
         switch (cmd) {
             case APP_CMD_INIT_WINDOW: {
                 if (mApp->window != nullptr) {
-                    mRenderer = std::make_unique<EGLRenderer>(mApp);
-                    mRenderer->initialize();
+                    mRenderer->onWindowCreated(mApp->window);
                 }
                 break;
             }
                 
             case APP_CMD_TERM_WINDOW: {
-                    if (mRenderer) {
-                        mRenderer->cleanup();
-                        mRenderer.reset();
-                    }
+                    mRenderer->onWindowDestroyed();
                     break;
                 }
+
+            case APP_CMD_WINDOW_RESIZED:
+            case APP_CMD_CONFIG_CHANGED: {
+                mRenderer->onWindowResized();
+                break;
+            }
+
+            case APP_CMD_RESUME: {
+                mResumed = true;
+                break;
+            }
+
+            case APP_CMD_PAUSE: {
+                mResumed = false;
+                break;
+            }
+
+            case APP_CMD_GAINED_FOCUS: {
+                mFocused = true;
+                break;
+            }
+
+            case APP_CMD_LOST_FOCUS: {
+                mFocused = false;
+                break;
+            }
             default: {}
         }
     }
+
+    // Only draw while the activity is in the foreground
+    void updateVisibility() {
+        bool visible = mResumed && mFocused;
+        if (visible != mVisible) {
+            mVisible = visible;
+            mRenderer->setVisible(visible);
+        }
+    }
     
 public:
     explicit NativeApp(android_app* app) : mApp(app) {
         mApp->userData = this;
         mApp->onAppCmd = handleAppCommand;
+        mApp->onInputEvent = handleInputEvent;
+
+        // Headless benchmark, e.g. adb shell setprop debug.nativeapp.benchmark 600
+        char benchmark[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.benchmark", benchmark);
+        auto benchmarkFrames = static_cast<uint32_t>(strtoul(benchmark, nullptr, 10));
+        mRenderer = createRenderer(app, mJobs, benchmarkFrames > 0);
+        mRenderer->setBenchmarkFrames(benchmarkFrames);
+
+        // Target rate, e.g. adb shell setprop debug.nativeapp.frame_rate half
+        char frameRate[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.frame_rate", frameRate);
+        mRenderer->setFrameRate(FramePacer::frameRateFromString(frameRate));
+
+        // Frame time overlay, e.g. adb shell setprop debug.nativeapp.hud 1
+        char hud[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.hud", hud);
+        mRenderer->setHudEnabled(hud[0] == '1');
+
+        // Culling kernel to compare, e.g. adb shell setprop debug.nativeapp.culling scalar
+        char culling[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.culling", culling);
+        mRenderer->setCullingKernel(FrustumCuller::kernelFromString(culling));
+
+        // Compute culling and indirect draws, e.g. adb shell setprop debug.nativeapp.gpu_culling 1
+        char gpuCulling[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.gpu_culling", gpuCulling);
+        mRenderer->setGpuCulling(gpuCulling[0] == '1');
+
+        // Drag prediction, e.g. adb shell setprop debug.nativeapp.touch_prediction 1
+        char touchPrediction[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.touch_prediction", touchPrediction);
+        mRenderer->setTouchPrediction(touchPrediction[0] == '1');
+
+        // Window colour depth, e.g. adb shell setprop debug.nativeapp.color_format 565
+        char colorFormat[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.color_format", colorFormat);
+        mRenderer->setColorFormat(colorFormatFromString(colorFormat));
+
+        // Scene resolution range, e.g. adb shell setprop debug.nativeapp.resolution_scale 0.5,1
+        char resolutionScale[PROP_VALUE_MAX] = {};
+        __system_property_get("debug.nativeapp.resolution_scale", resolutionScale);
+        float minScale = 1.0f;
+        float maxScale = 1.0f;
+        if (DynamicResolution::limitsFromString(resolutionScale, minScale, maxScale)) {
+            mRenderer->setResolutionScale(minScale, maxScale);
+        }
+
+        mJobs.start();
+        mJobs.registerThread();
+        mRenderer->start();
     }
     
     void run() {
         while (!mApp->destroyRequested) {
-            // Process events
+            // Rendering happens on the render thread, this loop only waits for events
             int events;
             android_poll_source* source;
-            while (ALooper_pollOnce(0, nullptr, &events, (void**)&source) >= 0) {
+            while (ALooper_pollOnce(-1, nullptr, &events, (void**)&source) >= 0) {
                 if (source) {
                     source->process(mApp, source);
                 }
-            }
-
-            // Render if initialized
-            if (mRenderer && mRenderer->isInitialized()) {
-                mRenderer->drawFrame();
+                if (mApp->destroyRequested) {
+                    return;
+                }
             }
         }
     }
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Packs a Wavefront OBJ into the binary mesh format read by MeshAsset.h.
+
+Vertices are written interleaved as half-float positions (location 0), when the OBJ
+has normals GL_INT_2_10_10_10_REV normals (location 6), and when it has texture
+coordinates unsigned normalized ones (location 7), or half floats if any fall outside
+[0, 1]. V is flipped, since OBJ puts the origin at the bottom and KTX2 rows start at the
+top. Indices are 16-bit when the vertex count allows, 32-bit otherwise.
+
+    tools/mesh_pack.py model.obj app/src/main/assets/meshes/scene.mesh
+"""
+
+import math
+import struct
+import sys
+
+MAGIC = 0x48534D4E  # "NMSH"
+VERSION = 1
+MAX_ATTRIBUTES = 8
+HEADER_SIZE = 112
+
+# VertexFormat values in VertexLayout.h
+HALF2 = 3
+HALF4 = 4
+INT_2_10_10_10 = 5
+USHORT2_NORM = 7
+
+POSITION_LOCATION = 0
+NORMAL_LOCATION = 6
+TEXCOORD_LOCATION = 7
+
+
+def snorm10(value):
+    value = max(-1.0, min(1.0, value))
+    return int(round(value * 511.0)) & 0x3FF
+
+
+def unorm16(value):
+    return int(round(max(0.0, min(1.0, value)) * 65535.0))
+
+
+def obj_index(value, count):
+    """OBJ indices are 1-based, negative ones count from the end; -1 when absent."""
+    if not value:
+        return -1
+    index = int(value)
+    return index - 1 if index > 0 else count + index
+
+
+def read_obj(path):
+    positions, texcoords, normals, corners = [], [], [], []
+    with open(path) as obj:
+        for line in obj:
+            parts = line.split()
+            if not parts:
+                continue
+            if parts[0] == "v":
+                positions.append(tuple(float(v) for v in parts[1:4]))
+            elif parts[0] == "vt":
+                texcoords.append(tuple(float(v) for v in parts[1:3]))
+            elif parts[0] == "vn":
+                normals.append(tuple(float(v) for v in parts[1:4]))
+            elif parts[0] == "f":
+                face = []
+                for corner in parts[1:]:
+                    fields = corner.split("/") + ["", ""]
+                    face.append((obj_index(fields[0], len(positions)),
+                                 obj_index(fields[1], len(texcoords)),
+                                 obj_index(fields[2], len(normals))))
+                for i in range(1, len(face) - 1):
+                    corners.extend((face[0], face[i], face[i + 1]))
+    return positions, texcoords, normals, corners
+
+
+def pack(obj_path, mesh_path):
+    positions, texcoords, normals, corners = read_obj(obj_path)
+    has_normals = bool(normals) and all(normal >= 0 for _, _, normal in corners)
+    has_texcoords = bool(texcoords) and all(texcoord >= 0 for _, texcoord, _ in corners)
+
+    vertices, remap, indices = [], {}, []
+    for position, texcoord, normal in corners:
+        key = (position, texcoord if has_texcoords else -1, normal if has_normals else -1)
+        if key not in remap:
+            remap[key] = len(vertices)
+            vertices.append(key)
+        indices.append(remap[key])
+
+    used = [positions[p] for p, _, _ in vertices]
+    low = [min(p[axis] for p in used) for axis in range(3)]
+    high = [max(p[axis] for p in used) for axis in range(3)]
+    center = [(l + h) * 0.5 for l, h in zip(low, high)]
+    radius = max(math.dist(center, p) for p in used)
+
+    flipped = {t: (texcoords[t][0], 1.0 - texcoords[t][1]) for _, t, _ in vertices if t >= 0}
+    texcoords_unorm = all(0.0 <= c <= 1.0 for uv in flipped.values() for c in uv)
+
+    vertex_blob = bytearray()
+    for position, texcoord, normal in vertices:
+        x, y, z = positions[position]
+        vertex_blob += struct.pack("<4e", x, y, z, 1.0)
+        if has_normals:
+            nx, ny, nz = normals[normal]
+            vertex_blob += struct.pack("<I", snorm10(nx) | snorm10(ny) << 10 | snorm10(nz) << 20)
+        if has_texcoords:
+            u, v = flipped[texcoord]
+            if texcoords_unorm:
+                vertex_blob += struct.pack("<2H", unorm16(u), unorm16(v))
+            else:
+                vertex_blob += struct.pack("<2e", u, v)
+
+    index_size = 2 if len(vertices) <= 0xFFFF else 4
+    index_blob = struct.pack("<%d%s" % (len(indices), "H" if index_size == 2 else "I"), *indices)
+
+    attributes = [(POSITION_LOCATION, HALF4)]
+    if has_normals:
+        attributes.append((NORMAL_LOCATION, INT_2_10_10_10))
+    if has_texcoords:
+        attributes.append((TEXCOORD_LOCATION, USHORT2_NORM if texcoords_unorm else HALF2))
+    attribute_words = []
+    for location, vertex_format in attributes + [(0, 0)] * (MAX_ATTRIBUTES - len(attributes)):
+        attribute_words += [location, vertex_format]
+
+    vertex_offset = HEADER_SIZE
+    index_offset = vertex_offset + len(vertex_blob)
+    index_offset += -index_offset % 4
+    header = struct.pack("<6I%dI2I4f" % (MAX_ATTRIBUTES * 2),
+                         MAGIC, VERSION, len(vertices), len(indices), index_size, len(attributes),
+                         *attribute_words, vertex_offset, index_offset, *center, radius)
+    assert len(header) == HEADER_SIZE
+
+    with open(mesh_path, "wb") as mesh:
+        mesh.write(header)
+        mesh.write(vertex_blob)
+        mesh.write(b"\0" * (index_offset - vertex_offset - len(vertex_blob)))
+        mesh.write(index_blob)
+
+    print("%s: %d vertices, %d triangles, %d-bit indices" %
+          (mesh_path, len(vertices), len(indices) // 3, index_size * 8))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: mesh_pack.py <input.obj> <output.mesh>")
+    pack(sys.argv[1], sys.argv[2])
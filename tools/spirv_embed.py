@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Compiles the GLSL in Shaders.h to SPIR-V and writes it out as a C++ header.
+
+Every `constexpr char <name>ShaderSource[]` raw string is built with glslc for Vulkan 1.1
+as a vertex or fragment shader, going by "vertex" or "fragment" in its name, and becomes
+`SpirvShaders::<name>Shader`. The GLES sources give their varyings no locations, so
+-fauto-map-locations assigns them in declaration order on both sides.
+Run by CMake on every change to Shaders.h:
+
+    tools/spirv_embed.py <glslc> app/src/main/cpp/Shaders.h <output.h>
+"""
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+SOURCE_PATTERN = re.compile(r'constexpr char (\w+)ShaderSource\[\] = R"\((.*?)\)";', re.DOTALL)
+
+
+def stage_for(name):
+    if "vertex" in name.lower():
+        return "vert"
+    if "fragment" in name.lower():
+        return "frag"
+    sys.exit("cannot tell the stage of %sShaderSource" % name)
+
+
+def compile_spirv(glslc, name, source):
+    with tempfile.TemporaryDirectory() as directory:
+        source_path = os.path.join(directory, name + ".glsl")
+        spirv_path = os.path.join(directory, name + ".spv")
+        with open(source_path, "w") as source_file:
+            source_file.write(source)
+        subprocess.run([glslc, "-fshader-stage=" + stage_for(name), "--target-env=vulkan1.1",
+                        "-fauto-map-locations", "-O", "-o", spirv_path, source_path], check=True)
+        with open(spirv_path, "rb") as spirv_file:
+            spirv = spirv_file.read()
+    return [int.from_bytes(spirv[i:i + 4], "little") for i in range(0, len(spirv), 4)]
+
+
+def embed(glslc, shaders_path, output_path):
+    with open(shaders_path) as shaders_file:
+        sources = SOURCE_PATTERN.findall(shaders_file.read())
+
+    lines = ["// Generated by tools/spirv_embed.py from Shaders.h, do not edit",
+             "#pragma once", "", "#include <cstdint>", "", "namespace SpirvShaders {"]
+    for name, source in sources:
+        words = compile_spirv(glslc, name, source)
+        lines.append("    constexpr uint32_t %sShader[] = {" % name)
+        for i in range(0, len(words), 8):
+            lines.append("        " + ", ".join("0x%08x" % word for word in words[i:i + 8]) + ",")
+        lines.append("    };")
+    lines.append("}")
+
+    os.makedirs(os.path.dirname(os.path.abspath(output_path)), exist_ok=True)
+    with open(output_path, "w") as output:
+        output.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4:
+        sys.exit("usage: spirv_embed.py <glslc> <Shaders.h> <output.h>")
+    embed(sys.argv[1], sys.argv[2], sys.argv[3])